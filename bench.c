@@ -0,0 +1,691 @@
+// Headless benchmark of the rendering code.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <epoxy/egl.h>
+
+#include "gl.h"
+#include "plasmacleaner.h"
+#include "realtime.h"
+#include "render_pool.h"
+#include "spanfill.h"
+#include "timing.h"
+
+// Frames rendered before timing starts, e.g. to build the bar cache.
+static const int BENCH_WARMUP_FRAMES = 5;
+// Each configuration runs for at least this many frames and then until
+// BENCH_MIN_NS has elapsed or BENCH_MAX_FRAMES have been rendered.
+#define BENCH_MIN_FRAMES 20
+#define BENCH_MAX_FRAMES 600
+static const gint64 BENCH_MIN_NS = 1000000000;
+// Refresh rate used to advance the bar between frames.
+static const int BENCH_REFRESH_HZ = 60;
+
+static const struct {
+  int width;
+  int height;
+} BENCH_RESOLUTIONS[] = {
+  { 1280, 720 },
+  { 1920, 1080 },
+  { 2560, 1440 },
+  { 3840, 2160 },
+  { 5120, 2880 },
+  { 7680, 4320 },
+  { 15360, 2160 },
+  // 4K in portrait.
+  { 2160, 3840 },
+};
+
+// The pattern's colours as x8r8g8b8 pixels, for the configuration being run.
+static guint32 bench_palette[MAX_PATTERN_COLOURS];
+
+static void pack_palette(const struct pattern_t *pattern,
+    guint32 palette[MAX_PATTERN_COLOURS]) {
+  for (int i = 0; i < pattern->n_colours; ++i) {
+    const struct colour_t *c = &pattern->colours[i];
+    palette[i] = pixel_format_pack(PIXEL_FORMAT_X8R8G8B8, c->r, c->g, c->b);
+  }
+}
+
+struct bench_backend_t {
+  const char *name;
+  // What is drawn.
+  const struct pattern_t *pattern;
+  // Draws one frame into cr after the bar moved from old_x to data->x, and
+  // returns the number of bytes of the target written.
+  gint64 (*draw)(struct data_t *data, cairo_t *cr, int width, int height,
+      int old_x);
+};
+
+// The bar as it was drawn before the pre-rendered row: a linear gradient
+// with a hard edge, evaluated across the whole window every frame. Kept as
+// a baseline for cairo below.
+static gint64 draw_gradient(struct data_t *data, cairo_t *cr, int width,
+    int height, int old_x) {
+  cairo_pattern_t *gradient = cairo_pattern_create_linear(0.0, 0.0, 1.0,
+      0.0);
+  cairo_pattern_add_color_stop_rgb(gradient, 0.0, BAR_COLOUR_R, BAR_COLOUR_G,
+      BAR_COLOUR_B);
+  cairo_pattern_add_color_stop_rgb(gradient, BAR_FRACTION, BAR_COLOUR_R,
+      BAR_COLOUR_G, BAR_COLOUR_B);
+  cairo_pattern_add_color_stop_rgb(gradient, BAR_FRACTION, 0.0, 0.0, 0.0);
+  cairo_pattern_add_color_stop_rgb(gradient, 1.0, 0.0, 0.0, 0.0);
+  cairo_pattern_set_extend(gradient, CAIRO_EXTEND_REPEAT);
+  cairo_translate(cr, data->x, 0.0);
+  cairo_scale(cr, width, 1.0);
+  cairo_set_source(cr, gradient);
+  cairo_paint(cr);
+  cairo_pattern_destroy(gradient);
+  return (gint64)width * height * 4;
+}
+
+// Equivalent to on_draw with a full-window invalidation.
+static gint64 draw_full(struct data_t *data, cairo_t *cr, int width,
+    int height, int old_x) {
+  draw_pattern(data, cr, width, height);
+  return (gint64)width * height * 4;
+}
+
+// Equivalent to on_draw with --damage-tracking.
+static gint64 draw_damage(struct data_t *data, cairo_t *cr, int width,
+    int height, int old_x) {
+  cairo_rectangle_int_t rects[MAX_DAMAGE_RECTS];
+  int n = span_program_get_damage(&data->program, old_x, data->x, rects);
+  if (n < 0) {
+    return draw_full(data, cr, width, height, old_x);
+  }
+  gint64 area = 0;
+  for (int i = 0; i < n; ++i) {
+    cairo_rectangle(cr, rects[i].x, rects[i].y, rects[i].width,
+        rects[i].height);
+    area += (gint64)rects[i].width * rects[i].height;
+  }
+  cairo_clip(cr);
+  draw_pattern(data, cr, width, height);
+  return area * 4;
+}
+
+// Equivalent to the client-side work of the xshm backend. The X server's
+// side of XShmPutImage is not included.
+static gint64 draw_xshm(struct data_t *data, cairo_t *cr, int width,
+    int height, int old_x) {
+  cairo_surface_t *surface = cairo_get_target(cr);
+  spanfill_frame(cairo_image_surface_get_data(surface),
+      cairo_image_surface_get_stride(surface), PIXEL_FORMAT_X8R8G8B8, 0, height,
+      &data->program.frame, bench_palette);
+  cairo_surface_mark_dirty(surface);
+  return (gint64)width * height * 4;
+}
+
+// Equivalent to the client-side work of the row backend, which renders one
+// row per band and leaves repeating it down the window to the X server.
+static gint64 draw_row(struct data_t *data, cairo_t *cr, int width,
+    int height, int old_x) {
+  cairo_surface_t *surface = cairo_get_target(cr);
+  const struct pattern_frame_t *frame = &data->program.frame;
+  for (int i = 0; i < frame->n_bands; ++i) {
+    spanfill_rows(cairo_image_surface_get_data(surface),
+        cairo_image_surface_get_stride(surface), PIXEL_FORMAT_X8R8G8B8, 0, 1,
+        frame->bands[i].spans, frame->bands[i].n_spans, bench_palette);
+  }
+  cairo_surface_mark_dirty(surface);
+  return (gint64)width * 4 * frame->n_bands;
+}
+
+// Equivalent to the client-side work of the column backend, which renders
+// one column and leaves repeating it across the window to the X server.
+static gint64 draw_column(struct data_t *data, cairo_t *cr, int width,
+    int height, int old_x) {
+  cairo_surface_t *surface = cairo_get_target(cr);
+  const struct pattern_frame_t *frame = &data->program.frame;
+  for (int i = 0; i < frame->n_bands; ++i) {
+    const struct band_t *band = &frame->bands[i];
+    const struct span_t pixel = { 0, 1, band->spans[0].colour };
+    spanfill_rows(cairo_image_surface_get_data(surface),
+        cairo_image_surface_get_stride(surface), PIXEL_FORMAT_X8R8G8B8,
+        band->y, band->height, &pixel, 1, bench_palette);
+  }
+  cairo_surface_mark_dirty(surface);
+  return (gint64)height * 4;
+}
+
+static const struct bench_backend_t BENCH_BACKENDS[] = {
+  { "cairo-gradient", &BAR_PATTERN, &draw_gradient },
+  { "cairo", &BAR_PATTERN, &draw_full },
+  { "cairo-damage", &BAR_PATTERN, &draw_damage },
+  { "xshm", &BAR_PATTERN, &draw_xshm },
+  { "row", &BAR_PATTERN, &draw_row },
+  // The vertical bar, rendered whole and by the two one-line backends.
+  { "xshm-vbar", &VBAR_PATTERN, &draw_xshm },
+  { "row-vbar", &VBAR_PATTERN, &draw_row },
+  { "column-vbar", &VBAR_PATTERN, &draw_column },
+};
+
+static int compare_gint64(const void *a, const void *b) {
+  gint64 x = *(const gint64 *)a;
+  gint64 y = *(const gint64 *)b;
+  return x < y ? -1 : x > y;
+}
+
+static gint64 percentile(const gint64 *sorted, int n, int p) {
+  return sorted[MIN(n - 1, n * p / 100)];
+}
+
+// Returns the bar position for frame i, sweeping once per PERIOD_MS at
+// BENCH_REFRESH_HZ.
+static guint get_bench_x(int i, int width) {
+  const int frames_per_period = PERIOD_MS * BENCH_REFRESH_HZ / 1000;
+  return (guint)((gint64)i * width / frames_per_period % width);
+}
+
+// Returns whether enough frames have been timed.
+static gboolean is_bench_done(int frames, gint64 total_ns) {
+  return frames == BENCH_MAX_FRAMES ||
+      (frames >= BENCH_MIN_FRAMES && total_ns >= BENCH_MIN_NS);
+}
+
+// Prints one row of the results table. Sorts samples.
+static void print_result(const char *name, int width, int height,
+    gint64 *samples, int frames, gint64 total_ns, gint64 bytes) {
+  qsort(samples, frames, sizeof(samples[0]), &compare_gint64);
+  char resolution[32];
+  g_snprintf(resolution, sizeof(resolution), "%dx%d", width, height);
+  g_print("%-14s %-12s %6d %9.1f %9.1f %9.1f %9.1f %9.1f %10.2f\n",
+      name, resolution, frames,
+      percentile(samples, frames, 50) / 1000.0,
+      percentile(samples, frames, 90) / 1000.0,
+      percentile(samples, frames, 99) / 1000.0,
+      samples[frames - 1] / 1000.0,
+      frames * 1e9 / total_ns,
+      (double)bytes / frames / (1024 * 1024));
+}
+
+static void run_config(const struct bench_backend_t *backend, int width,
+    int height) {
+  static gint64 samples[BENCH_MAX_FRAMES];
+
+  cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+      width, height);
+  struct data_t data = {0};
+  data.pattern = backend->pattern;
+  pack_palette(data.pattern, bench_palette);
+  span_program_compile(&data.program, data.pattern, width, height);
+
+  int frames = 0;
+  gint64 bytes = 0;
+  gint64 total_ns = 0;
+  for (int i = 0; ; ++i) {
+    int old_x = data.x;
+    data.x = get_bench_x(i, width);
+
+    gint64 start = get_monotonic_ns();
+    span_program_run(&data.program, data.x);
+    cairo_t *cr = cairo_create(surface);
+    gint64 frame_bytes = backend->draw(&data, cr, width, height, old_x);
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+    gint64 elapsed = get_monotonic_ns() - start;
+
+    if (i < BENCH_WARMUP_FRAMES) {
+      continue;
+    }
+    samples[frames++] = elapsed;
+    bytes += frame_bytes;
+    total_ns += elapsed;
+    if (is_bench_done(frames, total_ns)) {
+      break;
+    }
+  }
+
+  free_bar_cache(&data);
+  span_program_free(&data.program);
+  cairo_surface_destroy(surface);
+  print_result(backend->name, width, height, samples, frames, total_ns, bytes);
+}
+
+// Renders frames of the GL backend's shader into a width x height
+// renderbuffer of the current context. Each frame is timed until glFinish()
+// returns, so with a software renderer such as llvmpipe it includes the
+// rasterization, like the cairo rows above.
+static void run_gl_config(const struct gl_bar_t *bar, int width,
+    int height) {
+  static gint64 samples[BENCH_MAX_FRAMES];
+
+  GLuint framebuffer, renderbuffer;
+  glGenRenderbuffers(1, &renderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      GL_RENDERBUFFER, renderbuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+    glViewport(0, 0, width, height);
+    int frames = 0;
+    gint64 total_ns = 0;
+    for (int i = 0; ; ++i) {
+      gint64 start = get_monotonic_ns();
+      gl_bar_draw(bar, get_bench_x(i, width), width, get_bar_width(width));
+      glFinish();
+      gint64 elapsed = get_monotonic_ns() - start;
+
+      if (i < BENCH_WARMUP_FRAMES) {
+        continue;
+      }
+      samples[frames++] = elapsed;
+      total_ns += elapsed;
+      if (is_bench_done(frames, total_ns)) {
+        break;
+      }
+    }
+    print_result("gl", width, height, samples, frames, total_ns,
+        (gint64)width * height * 4 * frames);
+  } else {
+    g_print("%-14s %5dx%-6d unsupported framebuffer size\n", "gl", width,
+        height);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteRenderbuffers(1, &renderbuffer);
+}
+
+// Benchmarks the GL backend's shader with a surfaceless EGL context, so no
+// display is needed. On a machine without a GPU, Mesa provides llvmpipe.
+static void run_gl_bench(void) {
+  static const EGLint CONTEXT_ATTRIBUTES[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 2,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE,
+  };
+
+  if (!epoxy_has_egl_extension(EGL_NO_DISPLAY,
+      "EGL_MESA_platform_surfaceless")) {
+    g_print("gl: skipped (no surfaceless EGL platform)\n");
+    return;
+  }
+  EGLDisplay display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA,
+      EGL_DEFAULT_DISPLAY, NULL);
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+    g_print("gl: skipped (EGL initialization failed)\n");
+    return;
+  }
+  EGLContext context = EGL_NO_CONTEXT;
+  if (epoxy_has_egl_extension(display, "EGL_KHR_no_config_context") &&
+      epoxy_has_egl_extension(display, "EGL_KHR_surfaceless_context") &&
+      eglBindAPI(EGL_OPENGL_API)) {
+    context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT,
+        CONTEXT_ATTRIBUTES);
+  }
+  if (context == EGL_NO_CONTEXT ||
+      !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    g_print("gl: skipped (no OpenGL 3.2 surfaceless context)\n");
+    if (context != EGL_NO_CONTEXT) {
+      eglDestroyContext(display, context);
+    }
+    eglTerminate(display);
+    return;
+  }
+
+  struct gl_bar_t bar;
+  GError *error = NULL;
+  if (gl_bar_init(&bar, FALSE, &error)) {
+    for (size_t i = 0; i < G_N_ELEMENTS(BENCH_RESOLUTIONS); ++i) {
+      run_gl_config(&bar, BENCH_RESOLUTIONS[i].width,
+          BENCH_RESOLUTIONS[i].height);
+    }
+    g_print("(gl renderer: %s)\n", (const char *)glGetString(GL_RENDERER));
+    gl_bar_free(&bar);
+  } else {
+    g_print("gl: skipped (%s)\n", error->message);
+    g_error_free(error);
+  }
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglDestroyContext(display, context);
+  eglTerminate(display);
+}
+
+// Size of the buffer filled by the span fill benchmark (a 4K frame at 32 bpp).
+static const int SPANFILL_BENCH_WIDTH = 3840;
+static const int SPANFILL_BENCH_HEIGHT = 2160;
+static const int SPANFILL_BENCH_ITERATIONS = 50;
+
+// Returns the fill rate in GB/s of either memset (if kernel is NULL) or the
+// given span fill kernel filling whole rows of buffer.
+static double bench_fill(const struct spanfill_kernel_t *kernel,
+    enum pixel_format_t format, void *buffer) {
+  static const guint32 palette[1] = { 0 };
+  int stride = SPANFILL_BENCH_WIDTH * pixel_format_get_bytes(format);
+  size_t bytes = (size_t)stride * SPANFILL_BENCH_HEIGHT;
+  struct span_t span = { 0, SPANFILL_BENCH_WIDTH, 0 };
+  if (kernel) {
+    spanfill_set_kernel(kernel);
+  }
+
+  gint64 start = get_monotonic_ns();
+  for (int i = 0; i < SPANFILL_BENCH_ITERATIONS; ++i) {
+    if (kernel) {
+      spanfill_rows(buffer, stride, format, 0, SPANFILL_BENCH_HEIGHT, &span, 1,
+          palette);
+    } else {
+      memset(buffer, i, bytes);
+    }
+  }
+  gint64 elapsed = get_monotonic_ns() - start;
+  return (double)bytes * SPANFILL_BENCH_ITERATIONS / elapsed;
+}
+
+static void run_spanfill_bench(void) {
+  static const enum pixel_format_t FORMATS[] = {
+    PIXEL_FORMAT_X8R8G8B8,
+    PIXEL_FORMAT_R5G6B5,
+    PIXEL_FORMAT_A2R10G10B10,
+  };
+  void *buffer = g_malloc((size_t)SPANFILL_BENCH_WIDTH * SPANFILL_BENCH_HEIGHT *
+      4);
+  int n;
+  const struct spanfill_kernel_t *const *kernels = spanfill_get_kernels(&n);
+
+  g_print("\n%-14s %-12s %9s\n", "kernel", "format", "GB/s");
+  for (size_t i = 0; i < G_N_ELEMENTS(FORMATS); ++i) {
+    g_print("%-14s %-12s %9.2f\n", "memset", pixel_format_get_name(FORMATS[i]),
+        bench_fill(NULL, FORMATS[i], buffer));
+    for (int j = 0; j < n; ++j) {
+      g_print("%-14s %-12s %9.2f\n", kernels[j]->name,
+          pixel_format_get_name(FORMATS[i]),
+          bench_fill(kernels[j], FORMATS[i], buffer));
+    }
+  }
+  spanfill_set_kernel(spanfill_get_best_kernel());
+  g_free(buffer);
+}
+
+// Size of the frame rendered by the thread scaling benchmark: a video wall
+// of six 4K panels side by side.
+static const int SCALING_BENCH_WIDTH = 23040;
+static const int SCALING_BENCH_HEIGHT = 2160;
+static const int SCALING_BENCH_FRAMES = 20;
+
+struct scaling_frame_t {
+  int width;
+  guint32 *pixels;
+  struct span_t spans[MAX_BAR_SPANS];
+  int n_spans;
+  guint32 palette[MAX_PATTERN_COLOURS];
+};
+
+static void render_scaling_band(gpointer user_data, int y, int height) {
+  struct scaling_frame_t *frame = (struct scaling_frame_t *)user_data;
+  spanfill_rows(frame->pixels, frame->width * 4, PIXEL_FORMAT_X8R8G8B8, y,
+      height, frame->spans, frame->n_spans, frame->palette);
+}
+
+// Measures how the xshm backend's rendering scales with --threads.
+static void run_scaling_bench(void) {
+  struct scaling_frame_t frame;
+  frame.width = SCALING_BENCH_WIDTH;
+  frame.pixels = g_malloc((size_t)SCALING_BENCH_WIDTH * SCALING_BENCH_HEIGHT *
+      4);
+  pack_palette(&BAR_PATTERN, frame.palette);
+  int max_threads = MAX((int)g_get_num_processors(), 1);
+  double single_ms = 0.0;
+
+  g_print("\n%-8s %-12s %9s %9s %9s\n", "threads", "resolution",
+      "ms/frame", "frames/s", "speedup");
+  for (int threads = 1; threads <= max_threads; ++threads) {
+    struct render_pool_t *pool = render_pool_new(threads, NULL);
+    gint64 start = get_monotonic_ns();
+    for (int i = 0; i < SCALING_BENCH_FRAMES; ++i) {
+      frame.n_spans = get_bar_spans(SCALING_BENCH_WIDTH,
+          i * SCALING_BENCH_WIDTH / SCALING_BENCH_FRAMES, frame.spans);
+      render_pool_run(pool, SCALING_BENCH_HEIGHT, &render_scaling_band,
+          &frame);
+    }
+    double ms = (get_monotonic_ns() - start) / 1e6 / SCALING_BENCH_FRAMES;
+    render_pool_free(pool);
+    if (threads == 1) {
+      single_ms = ms;
+    }
+    g_print("%-8d %5dx%-6d %9.2f %9.1f %8.2fx\n", threads,
+        SCALING_BENCH_WIDTH, SCALING_BENCH_HEIGHT, ms, 1000 / ms,
+        single_ms / ms);
+  }
+  g_free(frame.pixels);
+}
+
+// Number of frames timed by the jitter benchmark in each mode: 5 s at
+// BENCH_REFRESH_HZ.
+#define JITTER_BENCH_FRAMES 300
+static const int JITTER_BENCH_PRIORITY = 10;
+
+struct jitter_run_t {
+  const struct realtime_t *rt;
+  gboolean applied;
+  gint64 intervals[JITTER_BENCH_FRAMES];
+  gint64 lateness[JITTER_BENCH_FRAMES];
+};
+
+static gpointer spin(gpointer user_data) {
+  gint *stop = (gint *)user_data;
+  volatile guint64 n = 0;
+  while (!g_atomic_int_get(stop)) {
+    ++n;
+  }
+  return NULL;
+}
+
+// Sleeps until each frame deadline in turn, the way the timing thread does,
+// and records how far apart and how late the wakeups were.
+static gpointer measure_jitter(gpointer user_data) {
+  struct jitter_run_t *run = (struct jitter_run_t *)user_data;
+  run->applied = !run->rt || realtime_apply(run->rt, "benchmark");
+
+  const gint64 interval_ns = 1000000000 / BENCH_REFRESH_HZ;
+  gint64 deadline = get_monotonic_ns() + interval_ns;
+  gint64 last = 0;
+  for (int i = -1; i < JITTER_BENCH_FRAMES; ++i, deadline += interval_ns) {
+    struct timespec ts = { deadline / 1000000000, deadline % 1000000000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+        EINTR) {
+    }
+    gint64 now = get_monotonic_ns();
+    if (i >= 0) {
+      run->intervals[i] = now - last;
+      run->lateness[i] = now - deadline;
+    }
+    last = now;
+  }
+  return NULL;
+}
+
+// Measures frame interval jitter with every CPU kept busy by other threads,
+// first with normal scheduling and then in real-time mode.
+static void run_jitter_bench(void) {
+  static struct jitter_run_t run;
+  const struct realtime_t rt = { SCHED_FIFO, JITTER_BENCH_PRIORITY, -1 };
+  const struct realtime_t *modes[] = { NULL, &rt };
+  int n_spinners = MAX((int)g_get_num_processors(), 1);
+  GThread **spinners = g_new(GThread *, n_spinners);
+
+  g_print("\n%-14s %6s %9s %9s %9s %9s\n", "scheduling", "frames",
+      "p50 us", "p99 us", "max us", "p99 late");
+  for (size_t i = 0; i < G_N_ELEMENTS(modes); ++i) {
+    gint stop = 0;
+    for (int j = 0; j < n_spinners; ++j) {
+      spinners[j] = g_thread_new("spinner", &spin, &stop);
+    }
+    run.rt = modes[i];
+    g_thread_join(g_thread_new("jitter", &measure_jitter, &run));
+    g_atomic_int_set(&stop, 1);
+    for (int j = 0; j < n_spinners; ++j) {
+      g_thread_join(spinners[j]);
+    }
+
+    qsort(run.intervals, JITTER_BENCH_FRAMES, sizeof(run.intervals[0]),
+        &compare_gint64);
+    qsort(run.lateness, JITTER_BENCH_FRAMES, sizeof(run.lateness[0]),
+        &compare_gint64);
+    g_print("%-14s %6d %9.1f %9.1f %9.1f %9.1f%s\n",
+        modes[i] ? "realtime" : "normal", JITTER_BENCH_FRAMES,
+        percentile(run.intervals, JITTER_BENCH_FRAMES, 50) / 1000.0,
+        percentile(run.intervals, JITTER_BENCH_FRAMES, 99) / 1000.0,
+        run.intervals[JITTER_BENCH_FRAMES - 1] / 1000.0,
+        percentile(run.lateness, JITTER_BENCH_FRAMES, 99) / 1000.0,
+        run.applied ? "" : " (not permitted)");
+  }
+  g_free(spinners);
+}
+
+// Size of the frame the timing benchmark renders on each tick: one 4K
+// screen, as the xshm backend would.
+static const int TIMING_BENCH_WIDTH = 3840;
+static const int TIMING_BENCH_HEIGHT = 2160;
+
+struct timing_run_t {
+  const struct realtime_t *rt;
+  gboolean started;
+  gboolean applied;
+  struct scaling_frame_t frame;
+  // Between wakeups on ticks, and from when each tick was due to the wakeup
+  // and to the end of its frame, in nanoseconds.
+  gint64 intervals[JITTER_BENCH_FRAMES];
+  gint64 wake_lateness[JITTER_BENCH_FRAMES];
+  gint64 done_lateness[JITTER_BENCH_FRAMES];
+};
+
+// Stands in for the main loop with --timing-thread: waits for each tick of a
+// timing thread and renders a frame for it with a render pool, with the
+// thread priorities --realtime would give them.
+static gpointer measure_timing(gpointer user_data) {
+  struct timing_run_t *run = (struct timing_run_t *)user_data;
+  run->applied = !run->rt || realtime_apply(run->rt, "benchmark");
+  struct realtime_t timing_rt;
+  if (run->rt) {
+    timing_rt = *run->rt;
+    ++timing_rt.priority;
+  }
+  struct timing_thread_t *timing = timing_thread_new(
+      G_USEC_PER_SEC / BENCH_REFRESH_HZ, run->rt ? &timing_rt : NULL);
+  run->started = timing != NULL;
+  if (!timing) {
+    return NULL;
+  }
+  struct render_pool_t *pool = render_pool_new(0, run->rt);
+
+  struct pollfd pfd = { timing_thread_get_fd(timing), POLLIN, 0 };
+  const int step = TIMING_BENCH_WIDTH / (PERIOD_MS * BENCH_REFRESH_HZ / 1000);
+  gint64 last = 0;
+  for (int i = -1; i < JITTER_BENCH_FRAMES; ++i) {
+    while (poll(&pfd, 1, -1) < 0 && errno == EINTR) {
+    }
+    struct timing_tick_t tick;
+    timing_thread_read(timing, &tick);
+    gint64 woke = get_monotonic_ns();
+    run->frame.n_spans = get_bar_spans(TIMING_BENCH_WIDTH,
+        (int)(tick.count * step % TIMING_BENCH_WIDTH), run->frame.spans);
+    render_pool_run(pool, TIMING_BENCH_HEIGHT, &render_scaling_band,
+        &run->frame);
+    gint64 done = get_monotonic_ns();
+    if (i >= 0) {
+      run->intervals[i] = woke - last;
+      run->wake_lateness[i] = woke - tick.time * 1000;
+      run->done_lateness[i] = done - tick.time * 1000;
+    }
+    last = woke;
+  }
+
+  render_pool_free(pool);
+  timing_thread_free(timing);
+  return NULL;
+}
+
+// Measures the jitter of the timing thread's ticks as seen by the main loop,
+// and how late a 4K frame rendered by the render pool on each tick is done,
+// with every CPU kept busy by other threads. This is run with normal
+// scheduling and then as --realtime=fifo would schedule it.
+static void run_timing_bench(void) {
+  static struct timing_run_t run;
+  const struct realtime_t rt = { SCHED_FIFO, JITTER_BENCH_PRIORITY, -1 };
+  const struct realtime_t *modes[] = { NULL, &rt };
+  int n_spinners = MAX((int)g_get_num_processors(), 1);
+  GThread **spinners = g_new(GThread *, n_spinners);
+  run.frame.width = TIMING_BENCH_WIDTH;
+  run.frame.pixels = g_malloc((size_t)TIMING_BENCH_WIDTH *
+      TIMING_BENCH_HEIGHT * 4);
+  pack_palette(&BAR_PATTERN, run.frame.palette);
+
+  g_print("\n%-14s %6s %9s %9s %9s %9s %9s\n", "timing thread", "frames",
+      "p50 us", "p99 us", "max us", "p99 woke", "p99 done");
+  for (size_t i = 0; i < G_N_ELEMENTS(modes); ++i) {
+    gint stop = 0;
+    for (int j = 0; j < n_spinners; ++j) {
+      spinners[j] = g_thread_new("spinner", &spin, &stop);
+    }
+    run.rt = modes[i];
+    g_thread_join(g_thread_new("timing bench", &measure_timing, &run));
+    g_atomic_int_set(&stop, 1);
+    for (int j = 0; j < n_spinners; ++j) {
+      g_thread_join(spinners[j]);
+    }
+    if (!run.started) {
+      continue;
+    }
+
+    qsort(run.intervals, JITTER_BENCH_FRAMES, sizeof(run.intervals[0]),
+        &compare_gint64);
+    qsort(run.wake_lateness, JITTER_BENCH_FRAMES,
+        sizeof(run.wake_lateness[0]), &compare_gint64);
+    qsort(run.done_lateness, JITTER_BENCH_FRAMES,
+        sizeof(run.done_lateness[0]), &compare_gint64);
+    g_print("%-14s %6d %9.1f %9.1f %9.1f %9.1f %9.1f%s\n",
+        modes[i] ? "realtime" : "normal", JITTER_BENCH_FRAMES,
+        percentile(run.intervals, JITTER_BENCH_FRAMES, 50) / 1000.0,
+        percentile(run.intervals, JITTER_BENCH_FRAMES, 99) / 1000.0,
+        run.intervals[JITTER_BENCH_FRAMES - 1] / 1000.0,
+        percentile(run.wake_lateness, JITTER_BENCH_FRAMES, 99) / 1000.0,
+        percentile(run.done_lateness, JITTER_BENCH_FRAMES, 99) / 1000.0,
+        run.applied ? "" : " (not permitted)");
+  }
+  g_free(run.frame.pixels);
+  g_free(spinners);
+}
+
+int run_bench(void) {
+  g_print("%-14s %-12s %6s %9s %9s %9s %9s %9s %10s\n", "backend",
+      "resolution", "frames", "p50 us", "p90 us", "p99 us", "max us",
+      "frames/s", "MiB/frame");
+  for (size_t i = 0; i < G_N_ELEMENTS(BENCH_BACKENDS); ++i) {
+    for (size_t j = 0; j < G_N_ELEMENTS(BENCH_RESOLUTIONS); ++j) {
+      run_config(&BENCH_BACKENDS[i], BENCH_RESOLUTIONS[j].width,
+          BENCH_RESOLUTIONS[j].height);
+    }
+  }
+  run_gl_bench();
+  run_spanfill_bench();
+  run_scaling_bench();
+  run_jitter_bench();
+  run_timing_bench();
+  return 0;
+}
@@ -0,0 +1,78 @@
+// Backend that renders a single column of each frame in client memory and
+// lets the X server repeat it across the window with XRender.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include "spanfill.h"
+#include "x11.h"
+
+static void column_destroy(struct data_t *data) {
+  struct x11_strip_t *strip = (struct x11_strip_t *)data->backend_data;
+  if (!strip) {
+    return;
+  }
+  x11_strip_destroy(strip);
+  g_free(strip);
+  data->backend_data = NULL;
+}
+
+static gboolean column_init(struct data_t *data) {
+  if (!data->pattern->same_columns) {
+    g_printerr("The column backend can only draw patterns whose columns are "
+        "all alike (vbar or cycle)\n");
+    return FALSE;
+  }
+  struct x11_strip_t *strip = g_new0(struct x11_strip_t, 1);
+  data->backend_data = strip;
+  if (!x11_strip_init(strip, data, X11_STRIP_COLUMN)) {
+    column_destroy(data);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void column_update(struct data_t *data, int old_x, gboolean full) {
+  struct x11_strip_t *strip = (struct x11_strip_t *)data->backend_data;
+  struct x11_window_t *xw = &strip->xw;
+  if (!x11_strip_update_size(strip)) {
+    gtk_widget_destroy(data->window);
+    return;
+  }
+
+  // Each band is one span across, so it is one pixel of the column.
+  const struct pattern_frame_t *frame = &data->program.frame;
+  for (int i = 0; i < frame->n_bands; ++i) {
+    const struct band_t *band = &frame->bands[i];
+    const struct span_t pixel = { 0, 1, band->spans[0].colour };
+    spanfill_rows(strip->image->data, strip->image->bytes_per_line,
+        strip->pixel_format, band->y, band->height, &pixel, 1,
+        strip->palette);
+  }
+  data->stats.x11_request_bytes += x11_strip_put(strip) +
+      x11_strip_composite(strip, 0, 0, xw->width, xw->height);
+  XFlush(xw->display);
+}
+
+const struct backend_t COLUMN_BACKEND = {
+  "column",
+  "render one column per frame and repeat it across the window with XRender",
+  &column_init,
+  &column_update,
+  &column_destroy,
+  FALSE,
+};
@@ -0,0 +1,296 @@
+// Backend that draws the bar with a fragment shader in a GtkGLArea. Works with
+// software GL (e.g. Mesa's llvmpipe) as well as with a GPU.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include "gl.h"
+
+// Each pixel is in the bar if it is less than u_bar_width columns to the
+// right of u_x, wrapping around at u_width. Coordinates are in device pixels
+// and gl_FragCoord is at pixel centres, so floor() gives the column.
+static const char VERTEX_SHADER[] =
+    "in vec2 position;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(position, 0.0, 1.0);\n"
+    "}\n";
+static const char FRAGMENT_SHADER[] =
+    "uniform float u_x;\n"
+    "uniform float u_width;\n"
+    "uniform float u_bar_width;\n"
+    "uniform vec3 u_colour;\n"
+    "out vec4 colour;\n"
+    "void main() {\n"
+    "  float offset = mod(floor(gl_FragCoord.x) - u_x, u_width);\n"
+    "  colour = vec4(offset < u_bar_width ? u_colour : vec3(0.0), 1.0);\n"
+    "}\n";
+static const char GL_SHADER_VERSION[] = "#version 150\n";
+static const char GLES_SHADER_VERSION[] =
+    "#version 300 es\n"
+    "precision highp float;\n";
+
+// Two triangles covering clip space, as a triangle strip.
+static const GLfloat QUAD[] = {
+  -1.0f, -1.0f,
+  1.0f, -1.0f,
+  -1.0f, 1.0f,
+  1.0f, 1.0f,
+};
+static const GLuint POSITION_ATTRIBUTE = 0;
+
+static GQuark gl_bar_error_quark(void) {
+  return g_quark_from_static_string("gl-bar-error");
+}
+
+// Returns a compiled shader, or 0 with error set.
+static GLuint compile_shader(GLenum type, const char *version,
+    const char *source, GError **error) {
+  GLuint shader = glCreateShader(type);
+  const GLchar *sources[] = { version, source };
+  glShaderSource(shader, G_N_ELEMENTS(sources), sources, NULL);
+  glCompileShader(shader);
+  GLint status;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if (status == GL_FALSE) {
+    GLint length;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    char *log = g_malloc(MAX(length, 1));
+    log[0] = '\0';
+    glGetShaderInfoLog(shader, length, NULL, log);
+    g_set_error(error, gl_bar_error_quark(), 0, "Shader compilation failed: %s",
+        log);
+    g_free(log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+// Returns a linked program, or 0 with error set.
+static GLuint link_program(const char *version, GError **error) {
+  GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, version,
+      VERTEX_SHADER, error);
+  if (!vertex_shader) {
+    return 0;
+  }
+  GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, version,
+      FRAGMENT_SHADER, error);
+  if (!fragment_shader) {
+    glDeleteShader(vertex_shader);
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex_shader);
+  glAttachShader(program, fragment_shader);
+  glBindAttribLocation(program, POSITION_ATTRIBUTE, "position");
+  glLinkProgram(program);
+  glDetachShader(program, vertex_shader);
+  glDetachShader(program, fragment_shader);
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+
+  GLint status;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (status == GL_FALSE) {
+    GLint length;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    char *log = g_malloc(MAX(length, 1));
+    log[0] = '\0';
+    glGetProgramInfoLog(program, length, NULL, log);
+    g_set_error(error, gl_bar_error_quark(), 0, "Shader linking failed: %s",
+        log);
+    g_free(log);
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+gboolean gl_bar_init(struct gl_bar_t *bar, gboolean es, GError **error) {
+  *bar = (struct gl_bar_t){0};
+  bar->program = link_program(es ? GLES_SHADER_VERSION : GL_SHADER_VERSION,
+      error);
+  if (!bar->program) {
+    return FALSE;
+  }
+  bar->x_location = glGetUniformLocation(bar->program, "u_x");
+  bar->width_location = glGetUniformLocation(bar->program, "u_width");
+  bar->bar_width_location = glGetUniformLocation(bar->program, "u_bar_width");
+  // The colour never changes, so it is set once here.
+  glUseProgram(bar->program);
+  glUniform3f(glGetUniformLocation(bar->program, "u_colour"), BAR_COLOUR_R,
+      BAR_COLOUR_G, BAR_COLOUR_B);
+
+  glGenVertexArrays(1, &bar->vertex_array);
+  glBindVertexArray(bar->vertex_array);
+  glGenBuffers(1, &bar->vertex_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, bar->vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(QUAD), QUAD, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(POSITION_ATTRIBUTE);
+  glVertexAttribPointer(POSITION_ATTRIBUTE, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+  glBindVertexArray(0);
+  return TRUE;
+}
+
+void gl_bar_draw(const struct gl_bar_t *bar, int x, int width, int bar_width) {
+  glUseProgram(bar->program);
+  glUniform1f(bar->x_location, x);
+  glUniform1f(bar->width_location, width);
+  glUniform1f(bar->bar_width_location, bar_width);
+  glBindVertexArray(bar->vertex_array);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glBindVertexArray(0);
+}
+
+void gl_bar_free(struct gl_bar_t *bar) {
+  if (bar->vertex_array) {
+    glDeleteVertexArrays(1, &bar->vertex_array);
+  }
+  if (bar->vertex_buffer) {
+    glDeleteBuffers(1, &bar->vertex_buffer);
+  }
+  if (bar->program) {
+    glDeleteProgram(bar->program);
+  }
+  *bar = (struct gl_bar_t){0};
+}
+
+struct gl_t {
+  GtkWidget *area;
+  struct gl_bar_t bar;
+  // Whether the bar was created in the area's context.
+  gboolean ready;
+  // Whether creating it failed, in which case the window is closed on the
+  // next update rather than from within realization.
+  gboolean failed;
+};
+
+static void on_gl_realize(GtkGLArea *area, gpointer user_data) {
+  struct data_t *data = (struct data_t *)user_data;
+  struct gl_t *gl = (struct gl_t *)data->backend_data;
+  gtk_gl_area_make_current(area);
+  GError *error = gtk_gl_area_get_error(area);
+  if (error) {
+    g_printerr("Failed to create GL context: %s\n", error->message);
+    gl->failed = TRUE;
+    return;
+  }
+  GdkGLContext *context = gtk_gl_area_get_context(area);
+  if (!gl_bar_init(&gl->bar, gdk_gl_context_get_use_es(context), &error)) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    gl->failed = TRUE;
+    return;
+  }
+  gl->ready = TRUE;
+}
+
+// Draws any pattern by clearing a scissor rectangle per span. frame is in
+// window pixels, and the viewport is scale times that, height rows high.
+static void draw_frame(const struct pattern_t *pattern,
+    const struct pattern_frame_t *frame, int scale, int height) {
+  glEnable(GL_SCISSOR_TEST);
+  for (int i = 0; i < frame->n_bands; ++i) {
+    const struct band_t *band = &frame->bands[i];
+    // GL's rows count up from the bottom.
+    int y = (height - band->y - band->height) * scale;
+    for (int j = 0; j < band->n_spans; ++j) {
+      const struct span_t *span = &band->spans[j];
+      const struct colour_t *c = &pattern->colours[span->colour];
+      glScissor(span->x * scale, y, span->len * scale, band->height * scale);
+      glClearColor(c->r, c->g, c->b, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+    }
+  }
+  glDisable(GL_SCISSOR_TEST);
+}
+
+static gboolean on_gl_render(GtkGLArea *area, GdkGLContext *context,
+    gpointer user_data) {
+  struct data_t *data = (struct data_t *)user_data;
+  struct gl_t *gl = (struct gl_t *)data->backend_data;
+  if (!gl->ready) {
+    return FALSE;
+  }
+  // Only the CPU's side is timed: GTK flushes the frame after this returns.
+  gint64 start_ns = get_monotonic_ns();
+  int scale = gtk_widget_get_scale_factor(GTK_WIDGET(area));
+  int width = gtk_widget_get_allocated_width(GTK_WIDGET(area));
+  int height = gtk_widget_get_allocated_height(GTK_WIDGET(area));
+  // The shader only knows the bar.
+  guint x = get_pattern_x(data, width);
+  if (data->pattern == &BAR_PATTERN) {
+    gl_bar_draw(&gl->bar, (int)x * scale, width * scale,
+        get_bar_width(width) * scale);
+  } else {
+    span_program_compile(&data->program, data->pattern, width, height);
+    draw_frame(data->pattern, span_program_run(&data->program, x), scale,
+        height);
+  }
+  stats_record_draw(&data->stats, get_monotonic_ns() - start_ns);
+  return TRUE;
+}
+
+static void gl_destroy(struct data_t *data) {
+  struct gl_t *gl = (struct gl_t *)data->backend_data;
+  if (!gl) {
+    return;
+  }
+  if (gl->ready) {
+    gtk_gl_area_make_current(GTK_GL_AREA(gl->area));
+    gl_bar_free(&gl->bar);
+  }
+  g_signal_handlers_disconnect_by_data(gl->area, data);
+  g_free(gl);
+  data->backend_data = NULL;
+}
+
+static gboolean gl_init(struct data_t *data) {
+  struct gl_t *gl = g_new0(struct gl_t, 1);
+  data->backend_data = gl;
+  gl->area = gtk_gl_area_new();
+  // The bar is opaque, and redrawn only when the sweep moves it.
+  gtk_gl_area_set_has_alpha(GTK_GL_AREA(gl->area), FALSE);
+  gtk_gl_area_set_auto_render(GTK_GL_AREA(gl->area), FALSE);
+  gtk_gl_area_set_required_version(GTK_GL_AREA(gl->area), 3, 2);
+  g_signal_connect(G_OBJECT(gl->area), "realize", G_CALLBACK(&on_gl_realize),
+      data);
+  g_signal_connect(G_OBJECT(gl->area), "render", G_CALLBACK(&on_gl_render),
+      data);
+  gtk_container_add(GTK_CONTAINER(data->window), gl->area);
+  gtk_widget_show(gl->area);
+  return TRUE;
+}
+
+static void gl_update(struct data_t *data, int old_x, gboolean full) {
+  struct gl_t *gl = (struct gl_t *)data->backend_data;
+  if (gl->failed) {
+    gtk_widget_destroy(data->window);
+    return;
+  }
+  gtk_gl_area_queue_render(GTK_GL_AREA(gl->area));
+}
+
+const struct backend_t GL_BACKEND = {
+  "gl",
+  "draw the bar with a fragment shader in a GtkGLArea",
+  &gl_init,
+  &gl_update,
+  &gl_destroy,
+  TRUE,
+};
@@ -0,0 +1,48 @@
+// OpenGL drawing of the bar, shared by the GL backend and the benchmark.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#ifndef GL_H_
+#define GL_H_
+
+#include <epoxy/gl.h>
+
+#include "plasmacleaner.h"
+
+// A full-screen quad whose fragment shader decides per pixel whether it is in
+// the bar, so drawing a frame is one uniform update and one draw call.
+struct gl_bar_t {
+  GLuint program;
+  GLuint vertex_array;
+  GLuint vertex_buffer;
+  GLint x_location;
+  GLint width_location;
+  GLint bar_width_location;
+};
+
+// Compiles the shaders and uploads the quad in the current context, which is
+// OpenGL ES 3.0 if es is TRUE and OpenGL 3.2 core otherwise. On failure,
+// frees what was created and returns FALSE with error set.
+gboolean gl_bar_init(struct gl_bar_t *bar, gboolean es, GError **error);
+// Draws the bar at column x of a viewport width pixels wide, with a bar of
+// bar_width pixels (both in device pixels).
+void gl_bar_draw(const struct gl_bar_t *bar, int x, int width, int bar_width);
+// Frees the GL objects. The context must be current.
+void gl_bar_free(struct gl_bar_t *bar);
+
+#endif  // GL_H_
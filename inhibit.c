@@ -0,0 +1,269 @@
+// Screensaver and idle inhibition.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <gdk/gdkx.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/scrnsaver.h>
+
+#include "inhibit.h"
+#include "plasmacleaner.h"
+#include "vclock.h"
+
+static const char APP_ID[] = "plasmacleaner";
+static const char REASON[] = "Cleaning the screen";
+// How long to wait for a D-Bus service to answer.
+static const int DBUS_TIMEOUT_MS = 5000;
+// The idle flag of org.gnome.SessionManager.Inhibit.
+static const guint32 GNOME_INHIBIT_IDLE = 8;
+// How often to simulate pointer motion when nothing else works.
+static const guint WARP_PERIOD_MS = 1000;
+
+struct inhibitor_t {
+  GtkWidget *window;
+  const struct inhibit_method_t *method;
+  GDBusConnection *bus;
+  // Returned by the D-Bus Inhibit call, and passed back to lift it.
+  guint32 cookie;
+  // The logind lock, which is held until it is closed.
+  int lock_fd;
+  Display *display;
+  guint warp_timeout_id;
+};
+
+struct inhibit_method_t {
+  const char *name;
+  // Inhibits idleness and returns TRUE, or returns FALSE if the method is
+  // unavailable.
+  gboolean (*inhibit)(struct inhibitor_t *inhibitor);
+  void (*uninhibit)(struct inhibitor_t *inhibitor);
+};
+
+// Calls a method on the session bus that takes args and returns a cookie.
+static gboolean call_inhibit(struct inhibitor_t *inhibitor,
+    const char *service, const char *path, const char *interface,
+    GVariant *args) {
+  GError *error = NULL;
+  inhibitor->bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+  if (!inhibitor->bus) {
+    g_debug("No session bus: %s", error->message);
+    g_error_free(error);
+    // Not using args would leak it.
+    g_variant_unref(g_variant_ref_sink(args));
+    return FALSE;
+  }
+  GVariant *result = g_dbus_connection_call_sync(inhibitor->bus, service, path,
+      interface, "Inhibit", args, G_VARIANT_TYPE("(u)"),
+      G_DBUS_CALL_FLAGS_NONE, DBUS_TIMEOUT_MS, NULL, &error);
+  if (!result) {
+    g_debug("%s.Inhibit failed: %s", interface, error->message);
+    g_error_free(error);
+    g_object_unref(inhibitor->bus);
+    inhibitor->bus = NULL;
+    return FALSE;
+  }
+  g_variant_get(result, "(u)", &inhibitor->cookie);
+  g_variant_unref(result);
+  return TRUE;
+}
+
+// Calls the method on the session bus that lifts the inhibition with the
+// cookie.
+static void call_uninhibit(struct inhibitor_t *inhibitor, const char *service,
+    const char *path, const char *interface, const char *method) {
+  GError *error = NULL;
+  GVariant *result = g_dbus_connection_call_sync(inhibitor->bus, service, path,
+      interface, method, g_variant_new("(u)", inhibitor->cookie), NULL,
+      G_DBUS_CALL_FLAGS_NONE, DBUS_TIMEOUT_MS, NULL, &error);
+  if (result) {
+    g_variant_unref(result);
+  } else {
+    // The service lifts it anyway once we disconnect.
+    g_debug("%s.%s failed: %s", interface, method, error->message);
+    g_error_free(error);
+  }
+  g_object_unref(inhibitor->bus);
+  inhibitor->bus = NULL;
+}
+
+static gboolean screensaver_inhibit(struct inhibitor_t *inhibitor) {
+  return call_inhibit(inhibitor, "org.freedesktop.ScreenSaver",
+      "/org/freedesktop/ScreenSaver", "org.freedesktop.ScreenSaver",
+      g_variant_new("(ss)", APP_ID, REASON));
+}
+
+static void screensaver_uninhibit(struct inhibitor_t *inhibitor) {
+  call_uninhibit(inhibitor, "org.freedesktop.ScreenSaver",
+      "/org/freedesktop/ScreenSaver", "org.freedesktop.ScreenSaver",
+      "UnInhibit");
+}
+
+// What gtk_application_inhibit() does, without needing a GtkApplication.
+static gboolean session_manager_inhibit(struct inhibitor_t *inhibitor) {
+  guint32 xid = 0;
+  GdkWindow *window = gtk_widget_get_window(inhibitor->window);
+  if (GDK_IS_X11_DISPLAY(gtk_widget_get_display(inhibitor->window))) {
+    xid = gdk_x11_window_get_xid(window);
+  }
+  return call_inhibit(inhibitor, "org.gnome.SessionManager",
+      "/org/gnome/SessionManager", "org.gnome.SessionManager",
+      g_variant_new("(susu)", APP_ID, xid, REASON, GNOME_INHIBIT_IDLE));
+}
+
+static void session_manager_uninhibit(struct inhibitor_t *inhibitor) {
+  call_uninhibit(inhibitor, "org.gnome.SessionManager",
+      "/org/gnome/SessionManager", "org.gnome.SessionManager", "Uninhibit");
+}
+
+static gboolean wayland_inhibit(struct inhibitor_t *inhibitor) {
+  return wayland_inhibit_idle(inhibitor->window);
+}
+
+static void wayland_uninhibit(struct inhibitor_t *inhibitor) {
+  wayland_uninhibit_idle();
+}
+
+static gboolean logind_inhibit(struct inhibitor_t *inhibitor) {
+  GError *error = NULL;
+  GDBusConnection *bus = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+  if (!bus) {
+    g_debug("No system bus: %s", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+  GUnixFDList *fds = NULL;
+  GVariant *result = g_dbus_connection_call_with_unix_fd_list_sync(bus,
+      "org.freedesktop.login1", "/org/freedesktop/login1",
+      "org.freedesktop.login1.Manager", "Inhibit",
+      g_variant_new("(ssss)", "idle", APP_ID, REASON, "block"),
+      G_VARIANT_TYPE("(h)"), G_DBUS_CALL_FLAGS_NONE, DBUS_TIMEOUT_MS, NULL,
+      &fds, NULL, &error);
+  g_object_unref(bus);
+  if (!result) {
+    g_debug("org.freedesktop.login1.Manager.Inhibit failed: %s",
+        error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+  gint32 index;
+  g_variant_get(result, "(h)", &index);
+  g_variant_unref(result);
+  inhibitor->lock_fd = g_unix_fd_list_get(fds, index, &error);
+  g_object_unref(fds);
+  if (inhibitor->lock_fd < 0) {
+    g_debug("No inhibitor lock: %s", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void logind_uninhibit(struct inhibitor_t *inhibitor) {
+  close(inhibitor->lock_fd);
+  inhibitor->lock_fd = -1;
+}
+
+// Returns the Xlib display of the window, or NULL if it is not on X11.
+static Display *get_x11_display(struct inhibitor_t *inhibitor) {
+  GdkDisplay *display = gtk_widget_get_display(inhibitor->window);
+  if (!GDK_IS_X11_DISPLAY(display)) {
+    return NULL;
+  }
+  return gdk_x11_display_get_xdisplay(display);
+}
+
+// This doesn't work with gnome-screensaver, which is why it comes after the
+// D-Bus methods.
+static gboolean xss_inhibit(struct inhibitor_t *inhibitor) {
+  inhibitor->display = get_x11_display(inhibitor);
+  int event_base, error_base, major, minor;
+  if (!inhibitor->display ||
+      !XScreenSaverQueryExtension(inhibitor->display, &event_base,
+          &error_base) ||
+      !XScreenSaverQueryVersion(inhibitor->display, &major, &minor) ||
+      major < 1 || (major == 1 && minor < 1)) {
+    // Suspend is new in version 1.1.
+    return FALSE;
+  }
+  XScreenSaverSuspend(inhibitor->display, True);
+  XFlush(inhibitor->display);
+  return TRUE;
+}
+
+static void xss_uninhibit(struct inhibitor_t *inhibitor) {
+  XScreenSaverSuspend(inhibitor->display, False);
+  XFlush(inhibitor->display);
+}
+
+static gboolean on_warp_timer(gpointer user_data) {
+  struct inhibitor_t *inhibitor = (struct inhibitor_t *)user_data;
+  // Synthesize a mouse event, but with an offset of 0x0, so that the pointer
+  // doesn't actually move.
+  XWarpPointer(inhibitor->display, None, None, 0, 0, 0, 0, 0, 0);
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean warp_inhibit(struct inhibitor_t *inhibitor) {
+  inhibitor->display = get_x11_display(inhibitor);
+  if (!inhibitor->display) {
+    return FALSE;
+  }
+  inhibitor->warp_timeout_id = vclock_add_timeout(WARP_PERIOD_MS * 1000,
+      &on_warp_timer, inhibitor);
+  return TRUE;
+}
+
+static void warp_uninhibit(struct inhibitor_t *inhibitor) {
+  vclock_remove_timeout(inhibitor->warp_timeout_id);
+}
+
+static const struct inhibit_method_t METHODS[] = {
+  { "org.freedesktop.ScreenSaver", &screensaver_inhibit,
+    &screensaver_uninhibit },
+  { "org.gnome.SessionManager", &session_manager_inhibit,
+    &session_manager_uninhibit },
+  { "wayland idle-inhibit", &wayland_inhibit, &wayland_uninhibit },
+  { "logind idle lock", &logind_inhibit, &logind_uninhibit },
+  { "XScreenSaverSuspend", &xss_inhibit, &xss_uninhibit },
+  { "pointer warp", &warp_inhibit, &warp_uninhibit },
+};
+
+struct inhibitor_t *inhibitor_new(GtkWidget *window) {
+  struct inhibitor_t *inhibitor = g_new0(struct inhibitor_t, 1);
+  inhibitor->window = window;
+  inhibitor->lock_fd = -1;
+  for (size_t i = 0; i < G_N_ELEMENTS(METHODS); ++i) {
+    if (METHODS[i].inhibit(inhibitor)) {
+      inhibitor->method = &METHODS[i];
+      g_debug("Inhibiting idleness with %s", METHODS[i].name);
+      return inhibitor;
+    }
+  }
+  g_printerr("Cannot keep the screen from blanking on this display\n");
+  return inhibitor;
+}
+
+void inhibitor_free(struct inhibitor_t *inhibitor) {
+  if (inhibitor->method) {
+    inhibitor->method->uninhibit(inhibitor);
+  }
+  g_free(inhibitor);
+}
@@ -0,0 +1,37 @@
+// Keeps the screen from blanking while the program runs.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#ifndef INHIBIT_H_
+#define INHIBIT_H_
+
+#include <gtk/gtk.h>
+
+struct inhibitor_t;
+
+// Inhibits idleness with the first method that works, in order:
+// org.freedesktop.ScreenSaver, org.gnome.SessionManager, the Wayland
+// idle-inhibit protocol, a systemd-logind idle inhibitor lock, and
+// XScreenSaverSuspend. If none works, falls back to simulating pointer
+// motion every second on X11. window is the window whose visibility
+// inhibits idleness, where the method supports one.
+struct inhibitor_t *inhibitor_new(GtkWidget *window);
+// Lifts the inhibition.
+void inhibitor_free(struct inhibitor_t *inhibitor);
+
+#endif  // INHIBIT_H_
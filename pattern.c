@@ -0,0 +1,315 @@
+// Patterns.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <assert.h>
+#include <string.h>
+
+#include "plasmacleaner.h"
+
+// Number of rows of checkerboard cells.
+static const int CHECKER_ROWS = 8;
+
+static const struct colour_t BAR_COLOURS[] = {
+  { 0.0, 0.0, 0.0 },
+  { BAR_COLOUR_R, BAR_COLOUR_G, BAR_COLOUR_B },
+};
+
+static const struct colour_t CHANNEL_COLOURS[] = {
+  { 1.0, 0.0, 0.0 },
+  { 0.0, 1.0, 0.0 },
+  { 0.0, 0.0, 1.0 },
+};
+
+static const struct colour_t CHECKER_COLOURS[] = {
+  { 0.0, 0.0, 0.0 },
+  { 1.0, 1.0, 1.0 },
+};
+
+static const struct colour_t CYCLE_COLOURS[] = {
+  { 1.0, 1.0, 1.0 },
+  { 1.0, 0.0, 0.0 },
+  { 0.0, 1.0, 0.0 },
+  { 0.0, 0.0, 1.0 },
+};
+
+static void allocate(struct span_program_t *program, int n_bands,
+    int n_spans) {
+  program->bands = g_new(struct band_t, n_bands);
+  program->n_bands = n_bands;
+  program->spans = g_new(struct span_t, n_spans);
+  program->n_spans = n_spans;
+}
+
+// Sets the row of a pattern that scrolls, and sizes the storage for
+// run_scrolling(), which splits at most one span in two.
+static void set_row(struct span_program_t *program, const struct span_t *row,
+    int n) {
+  program->row = g_new(struct span_t, n);
+  memcpy(program->row, row, n * sizeof(row[0]));
+  program->n_row = n;
+  allocate(program, 1, n + 1);
+}
+
+// Rotates the row right by x, keeping the spans in left to right order:
+// first whatever now wraps around into [0, x), then the rest.
+static void run_scrolling(struct span_program_t *program, guint x) {
+  int width = program->width;
+  int n = 0;
+  for (int i = 0; i < program->n_row; ++i) {
+    const struct span_t *span = &program->row[i];
+    int end = span->x + (int)x + span->len;
+    if (end > width) {
+      int start = MAX(span->x + (int)x, width);
+      program->spans[n++] = (struct span_t){ start - width, end - start,
+          span->colour };
+    }
+  }
+  for (int i = 0; i < program->n_row; ++i) {
+    const struct span_t *span = &program->row[i];
+    int start = span->x + (int)x;
+    if (start < width) {
+      program->spans[n++] = (struct span_t){ start,
+          MIN(start + span->len, width) - start, span->colour };
+    }
+  }
+  program->bands[0] = (struct band_t){ 0, program->height, program->spans, n };
+  program->frame = (struct pattern_frame_t){ program->bands, 1 };
+}
+
+static void compile_bar(struct span_program_t *program) {
+  struct span_t row[MAX_BAR_SPANS];
+  set_row(program, row, get_bar_spans(program->width, 0, row));
+}
+
+const struct pattern_t BAR_PATTERN = {
+  "bar",
+  "a light bar that sweeps left to right",
+  BAR_COLOURS,
+  G_N_ELEMENTS(BAR_COLOURS),
+  TRUE,
+  FALSE,
+  &compile_bar,
+  &run_scrolling,
+};
+
+// Red, green and blue bars a third of the width each, so that every pixel
+// spends a third of the period on each channel alone.
+static void compile_channels(struct span_program_t *program) {
+  int width = program->width;
+  struct span_t row[G_N_ELEMENTS(CHANNEL_COLOURS)];
+  for (int i = 0; i < (int)G_N_ELEMENTS(row); ++i) {
+    int start = width * i / (int)G_N_ELEMENTS(row);
+    int end = width * (i + 1) / (int)G_N_ELEMENTS(row);
+    row[i] = (struct span_t){ start, end - start, i };
+  }
+  set_row(program, row, G_N_ELEMENTS(row));
+}
+
+const struct pattern_t CHANNELS_PATTERN = {
+  "channels",
+  "red, green and blue bars that sweep left to right",
+  CHANNEL_COLOURS,
+  G_N_ELEMENTS(CHANNEL_COLOURS),
+  TRUE,
+  FALSE,
+  &compile_channels,
+  &run_scrolling,
+};
+
+// There are only two kinds of row, starting with either colour, so a frame
+// is n_rows bands that alternate between them, and the inverted frame is the
+// same bands shifted by one row. Both frames are built here.
+static void compile_checker(struct span_program_t *program) {
+  int size = MAX(1, (program->height + CHECKER_ROWS - 1) / CHECKER_ROWS);
+  int n_rows = (program->height + size - 1) / size;
+  int n_columns = (program->width + size - 1) / size;
+  program->size = size;
+  allocate(program, n_rows * 2, n_columns * 2);
+  for (int first = 0; first < 2; ++first) {
+    for (int i = 0; i < n_columns; ++i) {
+      int x = i * size;
+      program->spans[first * n_columns + i] = (struct span_t){ x,
+          MIN(size, program->width - x), (first + i) % 2 };
+    }
+  }
+  for (int inverted = 0; inverted < 2; ++inverted) {
+    for (int i = 0; i < n_rows; ++i) {
+      int y = i * size;
+      program->bands[inverted * n_rows + i] = (struct band_t){ y,
+          MIN(size, program->height - y),
+          program->spans + (inverted + i) % 2 * n_columns, n_columns };
+    }
+  }
+}
+
+// Inverts halfway through the period.
+static void run_checker(struct span_program_t *program, guint x) {
+  int n_rows = program->n_bands / 2;
+  int inverted = x * 2 >= (guint)program->width;
+  program->frame = (struct pattern_frame_t){
+    program->bands + inverted * n_rows, n_rows };
+}
+
+const struct pattern_t CHECKER_PATTERN = {
+  "checker",
+  "a checkerboard that inverts every half period",
+  CHECKER_COLOURS,
+  G_N_ELEMENTS(CHECKER_COLOURS),
+  FALSE,
+  FALSE,
+  &compile_checker,
+  &run_checker,
+};
+
+// One single-span band per colour.
+static void compile_cycle(struct span_program_t *program) {
+  int n = G_N_ELEMENTS(CYCLE_COLOURS);
+  allocate(program, n, n);
+  for (int i = 0; i < n; ++i) {
+    program->spans[i] = (struct span_t){ 0, program->width, i };
+    program->bands[i] = (struct band_t){ 0, program->height,
+        &program->spans[i], 1 };
+  }
+}
+
+// Shows each colour for an equal part of the period.
+static void run_cycle(struct span_program_t *program, guint x) {
+  int i = (int)((gint64)x * program->n_bands / program->width);
+  program->frame = (struct pattern_frame_t){ &program->bands[i], 1 };
+}
+
+const struct pattern_t CYCLE_PATTERN = {
+  "cycle",
+  "fill the screen with white, red, green and blue in turn",
+  CYCLE_COLOURS,
+  G_N_ELEMENTS(CYCLE_COLOURS),
+  FALSE,
+  TRUE,
+  &compile_cycle,
+  &run_cycle,
+};
+
+// Two spans the width of the screen, background and bar, for up to
+// MAX_BAR_SPANS bands.
+static void compile_vbar(struct span_program_t *program) {
+  allocate(program, MAX_BAR_SPANS, 2);
+  for (int i = 0; i < 2; ++i) {
+    program->spans[i] = (struct span_t){ 0, program->width, i };
+  }
+}
+
+// The bar's rows are worked out like the horizontal bar's columns, along the
+// height instead, so it covers BAR_FRACTION of the height and sweeps it once
+// per period.
+static void run_vbar(struct span_program_t *program, guint x) {
+  int y = (int)((gint64)x * program->height / program->width);
+  struct span_t rows[MAX_BAR_SPANS];
+  int n = get_bar_spans(program->height, y, rows);
+  for (int i = 0; i < n; ++i) {
+    program->bands[i] = (struct band_t){ rows[i].x, rows[i].len,
+        &program->spans[rows[i].colour], 1 };
+  }
+  program->frame = (struct pattern_frame_t){ program->bands, n };
+}
+
+const struct pattern_t VBAR_PATTERN = {
+  "vbar",
+  "a light bar that sweeps top to bottom",
+  BAR_COLOURS,
+  G_N_ELEMENTS(BAR_COLOURS),
+  FALSE,
+  TRUE,
+  &compile_vbar,
+  &run_vbar,
+};
+
+void span_program_compile(struct span_program_t *program,
+    const struct pattern_t *pattern, int width, int height) {
+  if (program->pattern == pattern && program->width == width &&
+      program->height == height) {
+    return;
+  }
+  span_program_free(program);
+  program->pattern = pattern;
+  program->width = width;
+  program->height = height;
+  pattern->compile(program);
+}
+
+const struct pattern_frame_t *span_program_run(struct span_program_t *program,
+    guint x) {
+  // Patterns index their storage by the phase.
+  assert(x < (guint)program->width);
+  program->pattern->run(program, x);
+  return &program->frame;
+}
+
+void span_program_free(struct span_program_t *program) {
+  g_free(program->bands);
+  g_free(program->spans);
+  g_free(program->row);
+  memset(program, 0, sizeof(*program));
+}
+
+int pattern_frame_count_spans(const struct pattern_frame_t *frame) {
+  int n = 0;
+  for (int i = 0; i < frame->n_bands; ++i) {
+    n += frame->bands[i].n_spans;
+  }
+  return n;
+}
+
+// Appends the columns [x, x + len) of the screen to rects, splitting the
+// strip in two where it crosses the wrap-around seam at the right edge.
+static int add_damage_columns(int width, int height, int x, int len,
+    cairo_rectangle_int_t *rects) {
+  int n = 0;
+  x = ((x % width) + width) % width;
+  if (x + len > width) {
+    rects[n++] = (cairo_rectangle_int_t){ 0, 0, x + len - width, height };
+    len = width - x;
+  }
+  rects[n++] = (cairo_rectangle_int_t){ x, 0, len, height };
+  return n;
+}
+
+// The damage is a strip at each edge between spans, as wide as the step.
+int span_program_get_damage(const struct span_program_t *program, int old_x,
+    int new_x, cairo_rectangle_int_t rects[MAX_DAMAGE_RECTS]) {
+  if (!program->pattern->scrolls ||
+      program->n_row * 2 > MAX_DAMAGE_RECTS) {
+    return -1;
+  }
+  int width = program->width;
+  int step = ((new_x - old_x) % width + width) % width;
+  // Spans cover whole pixels, so only the columns an edge moves across
+  // change.
+  for (int i = 0; i < program->n_row; ++i) {
+    if (step > program->row[i].len) {
+      // The strips would overlap, so just repaint everything.
+      return -1;
+    }
+  }
+  int n = 0;
+  for (int i = 0; step && i < program->n_row; ++i) {
+    n += add_damage_columns(width, program->height,
+        old_x + program->row[i].x, step, rects + n);
+  }
+  return n;
+}
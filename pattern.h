@@ -0,0 +1,129 @@
+// Patterns, and the span programs they compile to.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#ifndef PATTERN_H_
+#define PATTERN_H_
+
+#include <cairo.h>
+#include <glib.h>
+
+// Maximum number of colours in a pattern.
+#define MAX_PATTERN_COLOURS 8
+
+struct colour_t {
+  double r;
+  double g;
+  double b;
+};
+
+// A run of pixels in a row that are all one colour, as an index into the
+// pattern's colours.
+struct span_t {
+  int x;
+  int len;
+  int colour;
+};
+
+// Rows [y, y + height) of a frame, which are all made of the same spans,
+// left to right.
+struct band_t {
+  int y;
+  int height;
+  const struct span_t *spans;
+  int n_spans;
+};
+
+// What is on the screen for one frame: every row, top to bottom, as bands.
+struct pattern_frame_t {
+  const struct band_t *bands;
+  int n_bands;
+};
+
+struct span_program_t;
+
+// Something to sweep the screen with. A pattern is compiled once per screen
+// size into a span program, which then only has to work out which bands and
+// spans make up the frame for a given phase.
+struct pattern_t {
+  const char *name;
+  const char *description;
+  // The colours spans refer to.
+  const struct colour_t *colours;
+  int n_colours;
+  // Whether every frame is a single band: the row at x = 0 rotated right by
+  // x. Backends can then move a pre-rendered row instead of rendering.
+  gboolean scrolls;
+  // Whether every band of every frame is a single span, so that all columns
+  // are alike and backends can render one column and repeat it across.
+  gboolean same_columns;
+  // Sets up program for program->width x program->height: sizes the storage
+  // and precomputes whatever doesn't depend on the phase.
+  void (*compile)(struct span_program_t *program);
+  // Points program->frame at the frame for bar position x in [0, width),
+  // i.e. for phase x / width of the period.
+  void (*run)(struct span_program_t *program, guint x);
+};
+
+extern const struct pattern_t BAR_PATTERN;
+extern const struct pattern_t CHANNELS_PATTERN;
+extern const struct pattern_t CHECKER_PATTERN;
+extern const struct pattern_t CYCLE_PATTERN;
+extern const struct pattern_t VBAR_PATTERN;
+
+// A pattern compiled for a screen size.
+struct span_program_t {
+  const struct pattern_t *pattern;
+  int width;
+  int height;
+  // A size in pixels precomputed by compile(), e.g. of a checkerboard cell.
+  int size;
+  // Storage that frames point into, allocated by compile().
+  struct band_t *bands;
+  int n_bands;
+  struct span_t *spans;
+  int n_spans;
+  // For a pattern that scrolls, the row at x = 0.
+  struct span_t *row;
+  int n_row;
+  // The frame from the last run.
+  struct pattern_frame_t frame;
+};
+
+// (Re-)compiles program if the pattern or size has changed.
+void span_program_compile(struct span_program_t *program,
+    const struct pattern_t *pattern, int width, int height);
+// Returns the frame for bar position x, which must be in [0, program->width).
+const struct pattern_frame_t *span_program_run(struct span_program_t *program,
+    guint x);
+void span_program_free(struct span_program_t *program);
+
+// Returns the number of spans in frame, over all of its bands.
+int pattern_frame_count_spans(const struct pattern_frame_t *frame);
+
+// Maximum number of rectangles returned by span_program_get_damage().
+#define MAX_DAMAGE_RECTS 6
+
+// Computes the area of the screen that changes when the bar moves from old_x
+// to new_x. Returns the number of rectangles written to rects, or -1 if the
+// whole screen should be repainted, which it always should be for a pattern
+// that doesn't scroll.
+int span_program_get_damage(const struct span_program_t *program, int old_x,
+    int new_x, cairo_rectangle_int_t rects[MAX_DAMAGE_RECTS]);
+
+#endif  // PATTERN_H_
@@ -20,75 +20,267 @@
 
 #include <assert.h>
 #include <gdk/gdkx.h>
+#include <glib-unix.h>
 #include <gtk/gtk.h>
-#include <X11/X.h>
-
-// Number of milliseconds for the bar to move across the screen (approximate).
-static const guint PERIOD_MS = 4000;
-// Bar's width as a fraction of the screen width.
-static const double BAR_FRACTION = 3.0/8;
-// How often to simulate mouse movement to suppress screensaver.
-static const guint SCREENSAVER_SUPPRESSION_PERIOD_MS = 1000;
-
-// Colour of the bar (slightly blue tint).
-static const double BAR_COLOUR_R = 0.9;
-static const double BAR_COLOUR_G = 0.9;
-static const double BAR_COLOUR_B = 1.0;
-
-struct data_t {
-  GtkWidget *window;
-  cairo_pattern_t *pattern;
-  guint draw_timeout_id;
-  guint draw_timeout_interval;
-  guint x;
-  int width;
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <X11/Xatom.h>
+
+#include "inhibit.h"
+#include "plasmacleaner.h"
+#include "realtime.h"
+#include "timing.h"
+
+// Whether to invalidate only the strips that changed since the last frame.
+static gboolean damage_tracking = FALSE;
+// Name of the backend to draw with.
+static gchar *backend_name = NULL;
+// Name of the pattern to sweep with.
+static gchar *pattern_name = NULL;
+// Number of threads to render with, for backends that render in software.
+static gint threads = 1;
+// Whether to open a window on every monitor instead of just the current one.
+static gboolean all_monitors = FALSE;
+// Maximum frames per second, or 0 to render on every refresh.
+static gint max_fps = 0;
+// Whether to bypass the window manager with an override-redirect window.
+static gboolean override_redirect = FALSE;
+// Seconds between switching the compositor bypass on and off, or 0 to leave
+// it on, and whether it is on.
+static gint compare_compositing = 0;
+static gboolean bypassing_compositor = TRUE;
+// Whether to keep time on a thread of its own rather than the frame clock.
+static gboolean timing_thread = FALSE;
+// Real-time scheduling policy ("fifo" or "rr") for the render and timing
+// threads, or NULL to leave scheduling alone, and its priority.
+static gchar *realtime_policy = NULL;
+static gint realtime_priority = 10;
+// The real-time settings for render pool threads, or NULL.
+static const struct realtime_t *pool_realtime = NULL;
+// CPU to pin the render and timing threads to, or -1.
+static gint cpu = -1;
+// Whether to run the headless render benchmark instead of the cleaner.
+static gboolean bench = FALSE;
+// Whether to run the self-tests instead.
+static gboolean self_test = FALSE;
+// Whether to simulate a session in virtual time instead, and how.
+static gboolean virtual_time = FALSE;
+static struct simulation_t simulation = { 4.0, NULL, 0, 0.0, 0 };
+
+// One data_t per window, in creation order.
+static GPtrArray *windows = NULL;
+
+static const GOptionEntry OPTIONS[] = {
+  { "damage-tracking", 'd', 0, G_OPTION_ARG_NONE, &damage_tracking,
+    "Repaint only the moving bar edges each frame", NULL },
+  { "backend", 'b', 0, G_OPTION_ARG_STRING, &backend_name,
+    "How to draw the bar (gtk, xshm, scroll, xlib, xrender, tile, gl, "
+    "wayland, present, row or column; default gtk)", "NAME" },
+  { "pattern", 'p', 0, G_OPTION_ARG_STRING, &pattern_name,
+    "What to sweep with (bar, vbar, channels, checker or cycle; default "
+    "bar)", "NAME" },
+  { "threads", 't', 0, G_OPTION_ARG_INT, &threads,
+    "Render with N threads (xshm backend; 0 for one per processor)", "N" },
+  { "all-monitors", 'a', 0, G_OPTION_ARG_NONE, &all_monitors,
+    "Sweep every monitor separately", NULL },
+  { "max-fps", 'f', 0, G_OPTION_ARG_INT, &max_fps,
+    "Render at most N frames per second, on every n-th refresh", "N" },
+  { "override-redirect", 'o', 0, G_OPTION_ARG_NONE, &override_redirect,
+    "Cover the screen without the window manager (X11 only)", NULL },
+  { "compare-compositing", 0, 0, G_OPTION_ARG_INT, &compare_compositing,
+    "Switch the compositor bypass on and off every N seconds and report "
+    "stats for each", "N" },
+  { "timing-thread", 'T', 0, G_OPTION_ARG_NONE, &timing_thread,
+    "Time frames on a separate thread instead of GTK's frame clock", NULL },
+  { "realtime", 'r', 0, G_OPTION_ARG_STRING, &realtime_policy,
+    "Schedule the render and timing threads with POLICY (fifo or rr), lock "
+    "memory and minimise timer slack", "POLICY" },
+  { "realtime-priority", 0, 0, G_OPTION_ARG_INT, &realtime_priority,
+    "Real-time priority of the render thread (default 10; the timing "
+    "thread gets N + 1)", "N" },
+  { "cpu", 0, 0, G_OPTION_ARG_INT, &cpu,
+    "Pin the render and timing threads to CPU N", "N" },
+  { "bench", 0, 0, G_OPTION_ARG_NONE, &bench,
+    "Benchmark offscreen rendering and exit (no display needed)", NULL },
+  { "self-test", 0, 0, G_OPTION_ARG_NONE, &self_test,
+    "Check the rendering code against reference implementations and exit",
+    NULL },
+  { "virtual-time", 0, 0, G_OPTION_ARG_NONE, &virtual_time,
+    "Simulate a session in virtual time, report exposure and exit", NULL },
+  { "duration", 0, 0, G_OPTION_ARG_DOUBLE, &simulation.hours,
+    "Length of the simulated session (default 4)", "HOURS" },
+  { "slow-frames", 0, 0, G_OPTION_ARG_DOUBLE, &simulation.slow_frame_percent,
+    "Stall the simulated main loop after PERCENT of frames", "PERCENT" },
+  { "resize-every", 0, 0, G_OPTION_ARG_INT, &simulation.resize_minutes,
+    "Rotate the simulated screen every N minutes", "N" },
+  { NULL }
 };
 
-static void free_draw_timeout(struct data_t *data) {
-  if (data->draw_timeout_id) {
-    g_source_remove(data->draw_timeout_id);
-    data->draw_timeout_id = 0;
+// Invalidates only what changed when the bar moved from old_x to new_x.
+static void queue_draw_bar_motion(GtkWidget *widget,
+    const struct span_program_t *program, int old_x, int new_x) {
+  cairo_rectangle_int_t rects[MAX_DAMAGE_RECTS];
+  int n = span_program_get_damage(program, old_x, new_x, rects);
+  if (n < 0) {
+    gtk_widget_queue_draw(widget);
+    return;
+  }
+  for (int i = 0; i < n; ++i) {
+    gtk_widget_queue_draw_area(widget, rects[i].x, rects[i].y, rects[i].width,
+        rects[i].height);
   }
 }
 
-static gboolean on_draw_timer(gpointer user_data) {
-  struct data_t *data = (struct data_t *)user_data;
-  assert(data->width);
-  data->x = (data->x + 1) % data->width;
-  gtk_widget_queue_draw(data->window);
-  return TRUE;
+// Returns the serial number of the next X11 request on widget's display, or
+// 0 if it is not an X11 display.
+static unsigned long get_next_x11_request(GtkWidget *widget) {
+  GdkDisplay *display = gtk_widget_get_display(widget);
+  if (!GDK_IS_X11_DISPLAY(display)) {
+    return 0;
+  }
+  return XNextRequest(gdk_x11_display_get_xdisplay(display));
 }
 
 static gboolean on_draw(GtkWidget *widget, cairo_t *cr, gpointer user_data) {
   struct data_t *data = (struct data_t *)user_data;
+  gint64 start_ns = get_monotonic_ns();
+  unsigned long start_request = get_next_x11_request(widget);
 
   int width = gtk_widget_get_allocated_width(widget);
   assert(width);
 
-  // (Re-)register draw timeout if interval has changed.
-  guint draw_timeout_interval = PERIOD_MS / width;
-  if (data->draw_timeout_interval != draw_timeout_interval) {
-    free_draw_timeout(data);
-    data->draw_timeout_id = g_timeout_add(draw_timeout_interval, &on_draw_timer,
-        data);
-    data->draw_timeout_interval = draw_timeout_interval;
+  // Nothing to do if none of the window needs repainting. Otherwise cairo
+  // restricts the paint to the invalidated strips.
+  GdkRectangle clip;
+  if (!gdk_cairo_get_clip_rectangle(cr, &clip)) {
+    return TRUE;
+  }
+
+  draw_pattern(data, cr, width, gtk_widget_get_allocated_height(widget));
+
+  stats_record_draw(&data->stats, get_monotonic_ns() - start_ns);
+  data->stats.x11_requests += get_next_x11_request(widget) - start_request;
+  return TRUE;
+}
+
+static gboolean gtk_backend_init(struct data_t *data) {
+  g_signal_connect(G_OBJECT(data->window), "draw", G_CALLBACK(&on_draw), data);
+  return TRUE;
+}
+
+static void gtk_backend_update(struct data_t *data, int old_x, gboolean full) {
+  if (damage_tracking && !full) {
+    queue_draw_bar_motion(data->window, &data->program, old_x, data->x);
+  } else {
+    gtk_widget_queue_draw(data->window);
   }
+}
+
+static void gtk_backend_destroy(struct data_t *data) {
+  free_bar_cache(data);
+}
+
+static const struct backend_t GTK_BACKEND = {
+  "gtk",
+  "paint with cairo from GTK's draw signal",
+  &gtk_backend_init,
+  &gtk_backend_update,
+  &gtk_backend_destroy,
+  TRUE,
+};
+
+static const struct backend_t *const BACKENDS[] = {
+  &GTK_BACKEND,
+  &XSHM_BACKEND,
+  &SCROLL_BACKEND,
+  &XLIB_BACKEND,
+  &XRENDER_BACKEND,
+  &TILE_BACKEND,
+  &GL_BACKEND,
+  &WAYLAND_BACKEND,
+  &PRESENT_BACKEND,
+  &ROW_BACKEND,
+  &COLUMN_BACKEND,
+};
 
-  // Scale x if width changed.
-  if (data->width != width) {
-    if (data->width) {
-      data->x = data->x * width / data->width;
+static const struct pattern_t *const PATTERNS[] = {
+  &BAR_PATTERN,
+  &VBAR_PATTERN,
+  &CHANNELS_PATTERN,
+  &CHECKER_PATTERN,
+  &CYCLE_PATTERN,
+};
+
+// Returns the window on the monitor with the shortest refresh interval, or the
+// first window if no monitor reports one. Its refreshes drive all the windows,
+// so that every window is ticked at least once per refresh.
+static struct data_t *get_fastest_window(void) {
+  struct data_t *fastest = g_ptr_array_index(windows, 0);
+  for (guint i = 1; i < windows->len; ++i) {
+    struct data_t *data = g_ptr_array_index(windows, i);
+    if (data->refresh_interval && (!fastest->refresh_interval ||
+        data->refresh_interval < fastest->refresh_interval)) {
+      fastest = data;
     }
-    data->width = width;
   }
+  return fastest;
+}
 
-  // Draw.
-  cairo_translate(cr, data->x, 0.0);
-  cairo_scale(cr, width, 1.0);
-  cairo_set_source(cr, data->pattern);
-  cairo_paint(cr);
+// Updates a window for a tick, and counts the X11 requests its backend
+// issues if it draws synchronously.
+static void tick_window(struct data_t *data, gint64 frame_time,
+    gint64 tick_interval) {
+  int width = gtk_widget_get_allocated_width(data->window);
+  int height = gtk_widget_get_allocated_height(data->window);
+  assert(width);
+  unsigned long start_request = get_next_x11_request(data->window);
+  update_window(data, frame_time, tick_interval, width, height);
+  // Backends destroy the window if they fail.
+  if (data->window && !data->backend->deferred) {
+    data->stats.x11_requests += get_next_x11_request(data->window) -
+        start_request;
+  }
+}
 
-  return TRUE;
+// Called once per frame by the frame clock of the window on the fastest
+// monitor, which drives all the windows so that there is only one wakeup per
+// frame. Each window still steps by its own monitor's refresh interval.
+static gboolean on_tick(GtkWidget *widget, GdkFrameClock *frame_clock,
+    gpointer unused) {
+  gint64 frame_time = gdk_frame_clock_get_frame_time(frame_clock);
+  gint64 tick_interval = get_fastest_window()->refresh_interval;
+  if (!tick_interval) {
+    gdk_frame_clock_get_refresh_info(frame_clock, frame_time, &tick_interval,
+        NULL);
+  }
+  for (guint i = 0; i < windows->len; ++i) {
+    struct data_t *data = g_ptr_array_index(windows, i);
+    if (data->window) {
+      tick_window(data, frame_time, tick_interval);
+    }
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+// Called on the main loop after the timing thread ticks. Any ticks missed
+// while the main loop was busy are coalesced, and the windows are updated for
+// when the latest tick was due.
+static gboolean on_timing_tick(gint fd, GIOCondition condition,
+    gpointer user_data) {
+  struct timing_thread_t *timing = (struct timing_thread_t *)user_data;
+  struct timing_tick_t tick;
+  timing_thread_read(timing, &tick);
+  struct data_t *fastest = get_fastest_window();
+  gint64 tick_interval = fastest->refresh_interval ?
+      fastest->refresh_interval : DEFAULT_REFRESH_INTERVAL;
+  for (guint i = 0; i < windows->len; ++i) {
+    struct data_t *data = g_ptr_array_index(windows, i);
+    if (data->window) {
+      tick_window(data, tick.time, tick_interval);
+    }
+  }
+  return G_SOURCE_CONTINUE;
 }
 
 static gboolean on_button_or_key_press(GtkWidget *widget, GdkEvent *event,
@@ -97,65 +289,402 @@ static gboolean on_button_or_key_press(GtkWidget *widget, GdkEvent *event,
   return TRUE;
 }
 
+static void on_unrealize(GtkWidget *widget, gpointer user_data) {
+  struct data_t *data = (struct data_t *)user_data;
+  data->backend->destroy(data);
+}
+
+// Closing any window quits.
 static void on_destroy(GtkWidget *widget, gpointer user_data) {
   struct data_t *data = (struct data_t *)user_data;
-  free_draw_timeout(data);
-  gtk_main_quit();
+  data->window = NULL;
+  if (gtk_main_level()) {
+    gtk_main_quit();
+  }
 }
 
-static gboolean on_screensaver_suppression_timer(gpointer unused) {
-  // The XScreenSaverSuspend method doesn't work with gnome-screensaver, so
-  // instead we synthesize a mouse mouse event (but with offset of 0x0, so it
-  // doesn't actually move).
-  Display *display = gdk_x11_display_get_xdisplay(gdk_display_get_default());
-  assert(display);
-  XWarpPointer(display, None, None, 0, 0, 0, 0, 0, 0);
-  return TRUE;
+// Marks the whole window as opaque, so that a compositor can skip blending
+// it with what is underneath.
+static void set_opaque_region(GtkWidget *widget, int width, int height) {
+  cairo_rectangle_int_t rect = { 0, 0, width, height };
+  cairo_region_t *region = cairo_region_create_rectangle(&rect);
+  gdk_window_set_opaque_region(gtk_widget_get_window(widget), region);
+  cairo_region_destroy(region);
 }
 
-int main(int argc, char **argv) {
-  gtk_init(&argc, &argv);
-
-  struct data_t data = {0};
-
-  data.window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
-  assert(data.window);
-  gtk_window_set_title(GTK_WINDOW(data.window), "Plasma Cleaner");
-  gtk_window_set_keep_above(GTK_WINDOW(data.window), TRUE);
-  gtk_widget_add_events(data.window, GDK_BUTTON_PRESS_MASK|GDK_KEY_PRESS_MASK);
-  gtk_window_fullscreen(GTK_WINDOW(data.window));
-  g_signal_connect(G_OBJECT(data.window), "draw", G_CALLBACK(&on_draw), &data);
-  g_signal_connect(G_OBJECT(data.window), "destroy", G_CALLBACK(&on_destroy),
-      &data);
-  g_signal_connect(G_OBJECT(data.window), "button-press-event",
+// GTK allocates the window once before it has a GdkWindow, while realizing
+// it; set_bypass_compositor() covers that allocation.
+static void on_size_allocate(GtkWidget *widget, GdkRectangle *allocation,
+    gpointer unused) {
+  if (gtk_widget_get_realized(widget) && bypassing_compositor) {
+    set_opaque_region(widget, allocation->width, allocation->height);
+  }
+}
+
+// An override-redirect window never gets the keyboard focus, so grab the
+// keyboard to still exit on a key press.
+static gboolean on_map_event(GtkWidget *widget, GdkEvent *event,
+    gpointer unused) {
+  GdkSeat *seat = gdk_display_get_default_seat(gtk_widget_get_display(widget));
+  if (gdk_seat_grab(seat, gtk_widget_get_window(widget),
+      GDK_SEAT_CAPABILITY_KEYBOARD, FALSE, NULL, NULL, NULL, NULL) !=
+      GDK_GRAB_SUCCESS) {
+    g_printerr("Cannot grab the keyboard; click to exit\n");
+  }
+  return FALSE;
+}
+
+// Asks a compositing manager to unredirect the realized window, so that its
+// frames go straight to the screen rather than through a composite pass, and
+// marks it opaque; or, if bypass is FALSE, undoes both.
+static void set_bypass_compositor(GtkWidget *widget, gboolean bypass) {
+  if (bypass) {
+    set_opaque_region(widget, gtk_widget_get_allocated_width(widget),
+        gtk_widget_get_allocated_height(widget));
+  } else {
+    gdk_window_set_opaque_region(gtk_widget_get_window(widget), NULL);
+  }
+  GdkDisplay *display = gtk_widget_get_display(widget);
+  if (!GDK_IS_X11_DISPLAY(display)) {
+    return;
+  }
+  Display *xdisplay = gdk_x11_display_get_xdisplay(display);
+  Window xid = gdk_x11_window_get_xid(gtk_widget_get_window(widget));
+  Atom atom = gdk_x11_get_xatom_by_name_for_display(display,
+      "_NET_WM_BYPASS_COMPOSITOR");
+  if (bypass) {
+    long value = 1;
+    XChangeProperty(xdisplay, xid, atom, XA_CARDINAL, 32, PropModeReplace,
+        (unsigned char *)&value, 1);
+  } else {
+    XDeleteProperty(xdisplay, xid, atom);
+  }
+}
+
+// Switches the compositor bypass of every window, and starts recording each
+// window's ticks into the stats for the new phase.
+static gboolean on_compare_compositing_timeout(gpointer unused) {
+  bypassing_compositor = !bypassing_compositor;
+  for (guint i = 0; i < windows->len; ++i) {
+    struct data_t *data = g_ptr_array_index(windows, i);
+    if (!data->window) {
+      continue;
+    }
+    set_bypass_compositor(data->window, bypassing_compositor);
+    struct frame_stats_t stats = data->stats;
+    data->stats = data->other_stats;
+    data->other_stats = stats;
+    stats_pause(&data->stats);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+// Prints whether a compositing manager is running and how the windows avoid
+// its overhead.
+static void report_compositing(GdkDisplay *display) {
+  gboolean composited = gdk_screen_is_composited(
+      gdk_display_get_default_screen(display));
+  const char *path;
+  if (!GDK_IS_X11_DISPLAY(display)) {
+    path = "opaque region only";
+  } else if (override_redirect) {
+    path = "override-redirect window, unmanaged";
+  } else if (composited) {
+    path = "_NET_WM_BYPASS_COMPOSITOR and opaque region";
+  } else {
+    path = "nothing to bypass";
+  }
+  g_print("Compositing manager: %s; window path: %s\n",
+      composited ? "running" : "none", path);
+}
+
+static void dump_stats(void) {
+  for (guint i = 0; i < windows->len; ++i) {
+    struct data_t *data = g_ptr_array_index(windows, i);
+    if (!compare_compositing) {
+      stats_dump(&data->stats, data->name);
+      continue;
+    }
+    const struct frame_stats_t *bypassed = bypassing_compositor ?
+        &data->stats : &data->other_stats;
+    const struct frame_stats_t *composited = bypassing_compositor ?
+        &data->other_stats : &data->stats;
+    gchar *name = g_strdup_printf("%s, bypassing compositor", data->name);
+    stats_dump(bypassed, name);
+    g_free(name);
+    name = g_strdup_printf("%s, composited", data->name);
+    stats_dump(composited, name);
+    g_free(name);
+  }
+}
+
+static gboolean on_dump_stats_signal(gpointer unused) {
+  dump_stats();
+  return G_SOURCE_CONTINUE;
+}
+
+// Creates a fullscreen window on the given monitor, or on the current one if
+// monitor is NULL, and adds it to windows. Returns NULL if the backend can't
+// be used.
+static struct data_t *create_window(const struct backend_t *backend,
+    const struct pattern_t *pattern, GdkMonitor *monitor, int monitor_num) {
+  struct data_t *data = g_new0(struct data_t, 1);
+  data->backend = backend;
+  data->pattern = pattern;
+  data->threads = threads;
+  data->realtime = pool_realtime;
+  data->max_fps = max_fps;
+  if (monitor) {
+    const char *model = gdk_monitor_get_model(monitor);
+    data->name = g_strdup_printf("monitor %d (%s)", monitor_num,
+        model ? model : "unknown");
+  } else {
+    data->name = g_strdup("window");
+  }
+
+  data->window = gtk_window_new(override_redirect ? GTK_WINDOW_POPUP :
+      GTK_WINDOW_TOPLEVEL);
+  assert(data->window);
+  gtk_window_set_title(GTK_WINDOW(data->window), "Plasma Cleaner");
+  gtk_window_set_keep_above(GTK_WINDOW(data->window), TRUE);
+  gtk_widget_add_events(data->window,
+      GDK_BUTTON_PRESS_MASK|GDK_KEY_PRESS_MASK);
+  if (override_redirect) {
+    // Without a window manager, there is no fullscreen state: just cover the
+    // monitor.
+    GdkDisplay *display = gtk_widget_get_display(data->window);
+    GdkMonitor *target = monitor ? monitor :
+        gdk_display_get_primary_monitor(display);
+    if (!target) {
+      target = gdk_display_get_monitor(display, 0);
+    }
+    GdkRectangle geometry;
+    gdk_monitor_get_geometry(target, &geometry);
+    gtk_window_move(GTK_WINDOW(data->window), geometry.x, geometry.y);
+    gtk_window_resize(GTK_WINDOW(data->window), geometry.width,
+        geometry.height);
+    g_signal_connect(G_OBJECT(data->window), "map-event",
+        G_CALLBACK(&on_map_event), NULL);
+  } else if (monitor) {
+    GdkRectangle geometry;
+    gdk_monitor_get_geometry(monitor, &geometry);
+    gtk_window_move(GTK_WINDOW(data->window), geometry.x, geometry.y);
+    gtk_window_set_default_size(GTK_WINDOW(data->window), geometry.width,
+        geometry.height);
+    gtk_window_fullscreen_on_monitor(GTK_WINDOW(data->window),
+        gtk_widget_get_screen(data->window), monitor_num);
+  } else {
+    gtk_window_fullscreen(GTK_WINDOW(data->window));
+  }
+  g_signal_connect(G_OBJECT(data->window), "unrealize",
+      G_CALLBACK(&on_unrealize), data);
+  g_signal_connect(G_OBJECT(data->window), "destroy", G_CALLBACK(&on_destroy),
+      data);
+  g_signal_connect(G_OBJECT(data->window), "button-press-event",
       G_CALLBACK(&on_button_or_key_press), NULL);
-  g_signal_connect(G_OBJECT(data.window), "key-press-event",
+  g_signal_connect(G_OBJECT(data->window), "key-press-event",
       G_CALLBACK(&on_button_or_key_press), NULL);
-  gtk_widget_realize(data.window);
+  g_signal_connect(G_OBJECT(data->window), "size-allocate",
+      G_CALLBACK(&on_size_allocate), NULL);
+  gtk_widget_realize(data->window);
+  set_bypass_compositor(data->window, TRUE);
   GdkCursor *cursor = gdk_cursor_new(GDK_BLANK_CURSOR);
   assert(cursor);
-  gdk_window_set_cursor(gtk_widget_get_window(data.window), cursor);
+  gdk_window_set_cursor(gtk_widget_get_window(data->window), cursor);
   g_object_unref(cursor);
-  gtk_window_present(GTK_WINDOW(data.window));
-
-  data.pattern = cairo_pattern_create_linear(0.0, 0.0, 1.0, 0.0);
-  cairo_pattern_add_color_stop_rgb(data.pattern, 0.0, BAR_COLOUR_R,
-      BAR_COLOUR_G, BAR_COLOUR_B);
-  cairo_pattern_add_color_stop_rgb(data.pattern, BAR_FRACTION, BAR_COLOUR_R,
-      BAR_COLOUR_G, BAR_COLOUR_B);
-  cairo_pattern_add_color_stop_rgb(data.pattern, BAR_FRACTION, 0.0, 0.0, 0.0);
-  cairo_pattern_add_color_stop_rgb(data.pattern, 1.0, 0.0, 0.0, 0.0);
-  cairo_pattern_set_extend(data.pattern, CAIRO_EXTEND_REPEAT);
-
-  guint screensaver_suppression_timeout_id = g_timeout_add(
-      SCREENSAVER_SUPPRESSION_PERIOD_MS, &on_screensaver_suppression_timer,
+  if (!monitor) {
+    monitor = gdk_display_get_monitor_at_window(
+        gtk_widget_get_display(data->window),
+        gtk_widget_get_window(data->window));
+  }
+  // The refresh rate is in millihertz.
+  int refresh_rate = monitor ? gdk_monitor_get_refresh_rate(monitor) : 0;
+  if (refresh_rate > 0) {
+    data->refresh_interval = (gint64)1000000000 / refresh_rate;
+  }
+  g_ptr_array_add(windows, data);
+  if (!data->backend->init(data)) {
+    return NULL;
+  }
+  gtk_window_present(GTK_WINDOW(data->window));
+  return data;
+}
+
+static void free_windows(void) {
+  for (guint i = 0; i < windows->len; ++i) {
+    struct data_t *data = g_ptr_array_index(windows, i);
+    if (data->window) {
+      gtk_widget_destroy(data->window);
+    }
+    span_program_free(&data->program);
+    g_free(data->name);
+    g_free(data);
+  }
+  g_ptr_array_free(windows, TRUE);
+}
+
+int main(int argc, char **argv) {
+  GOptionContext *context = g_option_context_new(NULL);
+  g_option_context_add_main_entries(context, OPTIONS, NULL);
+  g_option_context_add_group(context, gtk_get_option_group(FALSE));
+  GError *error = NULL;
+  gboolean parsed = g_option_context_parse(context, &argc, &argv, &error);
+  g_option_context_free(context);
+  if (!parsed) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    return 1;
+  }
+
+  if (threads < 0) {
+    g_printerr("Invalid thread count: %d\n", threads);
+    return 1;
+  }
+  if (cpu < -1) {
+    g_printerr("Invalid CPU: %d\n", cpu);
+    return 1;
+  }
+  // The render thread's real-time settings, and the timing thread's, which
+  // preempts it.
+  struct realtime_t render_rt = { SCHED_OTHER, 0, cpu };
+  if (realtime_policy) {
+    int max_priority = sched_get_priority_max(SCHED_FIFO);
+    if (!realtime_parse_policy(realtime_policy, &render_rt.policy)) {
+      g_printerr("Unknown real-time policy: %s\n", realtime_policy);
+      return 1;
+    }
+    if (realtime_priority < 1 || realtime_priority >= max_priority) {
+      g_printerr("Invalid real-time priority: %d\n", realtime_priority);
+      return 1;
+    }
+    render_rt.priority = realtime_priority;
+    pool_realtime = &render_rt;
+  }
+  struct realtime_t timing_rt = render_rt;
+  if (realtime_policy) {
+    timing_rt.priority = realtime_priority + 1;
+  }
+  gboolean use_rt = realtime_policy || cpu >= 0;
+
+  const struct pattern_t *pattern = PATTERNS[0];
+  if (pattern_name) {
+    pattern = NULL;
+    for (size_t i = 0; i < G_N_ELEMENTS(PATTERNS); ++i) {
+      if (!strcmp(pattern_name, PATTERNS[i]->name)) {
+        pattern = PATTERNS[i];
+      }
+    }
+    if (!pattern) {
+      g_printerr("Unknown pattern: %s\n", pattern_name);
+      return 1;
+    }
+  }
+
+  if (bench) {
+    return run_bench();
+  }
+  if (self_test) {
+    return run_self_test();
+  }
+  if (virtual_time) {
+    simulation.pattern = pattern;
+    simulation.max_fps = max_fps;
+    return run_simulation(&simulation);
+  }
+
+  const struct backend_t *backend = BACKENDS[0];
+  if (backend_name) {
+    backend = NULL;
+    for (size_t i = 0; i < G_N_ELEMENTS(BACKENDS); ++i) {
+      if (!strcmp(backend_name, BACKENDS[i]->name)) {
+        backend = BACKENDS[i];
+      }
+    }
+    if (!backend) {
+      g_printerr("Unknown backend: %s\n", backend_name);
+      return 1;
+    }
+  }
+
+  if (!gtk_init_check(&argc, &argv)) {
+    g_printerr("Cannot open display\n");
+    return 1;
+  }
+
+  GdkDisplay *display = gdk_display_get_default();
+  if (override_redirect && !GDK_IS_X11_DISPLAY(display)) {
+    g_printerr("--override-redirect requires an X11 display\n");
+    return 1;
+  }
+  if (compare_compositing < 0 ||
+      (compare_compositing && override_redirect)) {
+    g_printerr("--compare-compositing needs a positive interval and a "
+        "managed window\n");
+    return 1;
+  }
+  report_compositing(display);
+
+  windows = g_ptr_array_new();
+  int n_monitors = all_monitors ? gdk_display_get_n_monitors(display) : 1;
+  for (int i = 0; i < n_monitors; ++i) {
+    GdkMonitor *monitor = all_monitors ? gdk_display_get_monitor(display, i) :
+        NULL;
+    if (!create_window(backend, pattern, monitor, i)) {
+      free_windows();
+      return 1;
+    }
+  }
+
+  struct data_t *first = g_ptr_array_index(windows, 0);
+  struct data_t *fastest = get_fastest_window();
+  struct timing_thread_t *timing = NULL;
+  guint timing_source_id = 0;
+  if (timing_thread) {
+    timing = timing_thread_new(fastest->refresh_interval ?
+        fastest->refresh_interval : DEFAULT_REFRESH_INTERVAL,
+        use_rt ? &timing_rt : NULL);
+  }
+  if (timing) {
+    timing_source_id = g_unix_fd_add(timing_thread_get_fd(timing), G_IO_IN,
+        &on_timing_tick, timing);
+  } else {
+    gtk_widget_add_tick_callback(fastest->window, &on_tick, NULL, NULL);
+  }
+
+  struct inhibitor_t *inhibitor = inhibitor_new(first->window);
+
+  // The main thread is made real-time after startup, so that GLib's helper
+  // threads keep their normal scheduling and don't all end up pinned to one
+  // CPU. Render pool workers take the policy but not the CPU themselves.
+  if (use_rt) {
+    realtime_apply(&render_rt, "render");
+  }
+  if (realtime_policy) {
+    realtime_lock_memory();
+  }
+
+  guint dump_stats_signal_id = g_unix_signal_add(SIGUSR1, &on_dump_stats_signal,
       NULL);
+  guint compare_source_id = compare_compositing ?
+      g_timeout_add_seconds(compare_compositing,
+          &on_compare_compositing_timeout, NULL) : 0;
 
   gtk_main();
 
-  g_source_remove(screensaver_suppression_timeout_id);
+  if (compare_source_id) {
+    g_source_remove(compare_source_id);
+  }
+  g_source_remove(dump_stats_signal_id);
+  dump_stats();
+
+  inhibitor_free(inhibitor);
+
+  if (timing) {
+    g_source_remove(timing_source_id);
+    timing_thread_free(timing);
+  }
 
-  cairo_pattern_destroy(data.pattern);
+  free_windows();
 
   return 0;
 }
@@ -0,0 +1,189 @@
+// Shared declarations for plasmacleaner.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#ifndef PLASMACLEANER_H_
+#define PLASMACLEANER_H_
+
+#include <gtk/gtk.h>
+
+#include "pattern.h"
+#include "stats.h"
+
+// Number of milliseconds for the bar to move across the screen.
+static const guint PERIOD_MS = 4000;
+// Bar's width as a fraction of the screen width.
+static const double BAR_FRACTION = 3.0/8;
+// Refresh interval in microseconds assumed when neither the monitor nor the
+// frame clock reports one (60 Hz).
+static const gint64 DEFAULT_REFRESH_INTERVAL = 16667;
+
+// Colour of the bar (slightly blue tint).
+static const double BAR_COLOUR_R = 0.9;
+static const double BAR_COLOUR_G = 0.9;
+static const double BAR_COLOUR_B = 1.0;
+
+struct data_t;
+struct realtime_t;
+
+// A way of getting the bar onto the screen.
+struct backend_t {
+  const char *name;
+  const char *description;
+  // Prepares to draw into data->window, which has been realized. Returns FALSE
+  // if the backend can't be used.
+  gboolean (*init)(struct data_t *data);
+  // Shows a frame with the bar moved from old_x to data->x. If full is TRUE,
+  // the window has been resized or damaged and must be redrawn completely.
+  void (*update)(struct data_t *data, int old_x, gboolean full);
+  // Frees resources. Called before data->window is unrealized.
+  void (*destroy)(struct data_t *data);
+  // Whether update() only schedules drawing for later, in which case the
+  // backend records the draw time itself.
+  gboolean deferred;
+};
+
+extern const struct backend_t COLUMN_BACKEND;
+extern const struct backend_t GL_BACKEND;
+extern const struct backend_t PRESENT_BACKEND;
+extern const struct backend_t ROW_BACKEND;
+extern const struct backend_t SCROLL_BACKEND;
+extern const struct backend_t TILE_BACKEND;
+extern const struct backend_t WAYLAND_BACKEND;
+extern const struct backend_t XLIB_BACKEND;
+extern const struct backend_t XRENDER_BACKEND;
+extern const struct backend_t XSHM_BACKEND;
+
+struct data_t {
+  // NULL once the window has been destroyed.
+  GtkWidget *window;
+  // Used to label statistics.
+  gchar *name;
+  const struct backend_t *backend;
+  void *backend_data;
+  // Number of threads backends may render with (0 for one per processor),
+  // and how to schedule them, or NULL to leave them alone.
+  int threads;
+  const struct realtime_t *realtime;
+  // Set (e.g. on an expose) to force a full redraw on the next tick.
+  gboolean damaged;
+  // What to draw, compiled for the window's size, and last run for x before
+  // the backend's update().
+  const struct pattern_t *pattern;
+  struct span_program_t program;
+  // One row of a pattern that scrolls, pre-rendered at bar_width and repeated
+  // in both directions when painting.
+  cairo_pattern_t *bar_pattern;
+  int bar_width;
+  // The monitor's refresh interval in microseconds, or 0 if unknown.
+  gint64 refresh_interval;
+  // Frame time (in microseconds) of the first tick, or 0 before it.
+  gint64 start_time;
+  // The refresh x was last updated for, which follows the frame times of the
+  // updates, in microseconds.
+  gint64 last_update_time;
+  // Maximum frames per second, or 0 to update on every refresh.
+  int max_fps;
+  // Bar position with sub-pixel precision, and rounded down to a column in
+  // [0, sweep_width), the width the sweep was last updated for.
+  double position;
+  guint x;
+  int sweep_width;
+  // For backends with presentation feedback: when the last frame reached the
+  // screen (in microseconds, on the frame clock's timebase), the refresh
+  // counter then, and the measured refresh interval, or 0 if unknown.
+  gint64 present_time;
+  guint64 present_msc;
+  gint64 present_interval;
+  // The refresh in which a frame submitted on this tick should reach the
+  // screen. The sweep is computed for that refresh's time rather than the
+  // tick's frame time.
+  guint64 next_present_msc;
+  int width;
+  int height;
+  struct frame_stats_t stats;
+  // With --compare-compositing, the stats of the phases that aren't running,
+  // swapped with stats at each switch.
+  struct frame_stats_t other_stats;
+};
+
+// Advances data->position and data->x to frame_time for a window of the
+// given width, by a fixed step per data->refresh_interval. tick_interval is
+// the interval between the ticks that drive the window, which may be shorter
+// than its own monitor's, or 0 if unknown; it is also the window's refresh
+// interval if that is unknown. Returns FALSE if no frame is due yet, having
+// only rescaled the position if the width changed.
+gboolean sweep_update(struct data_t *data, gint64 frame_time,
+    gint64 tick_interval, int width);
+// Updates a window of the given size for a tick at frame_time, where ticks
+// come every tick_interval microseconds: moves the sweep and, if the bar
+// moved or the window needs a full redraw, has the backend show the new
+// frame. The backend may destroy data->window.
+void update_window(struct data_t *data, gint64 frame_time,
+    gint64 tick_interval, int width, int height);
+
+// Maximum number of spans returned by get_bar_spans().
+#define MAX_BAR_SPANS 3
+
+// Returns the width in pixels of the bar on a screen of the given width (or
+// its height in pixels for a screen of that height, for the vertical bar).
+int get_bar_width(int width);
+// Splits a row of the given width into bar (colour 1) and background
+// (colour 0) spans for the bar at x in [0, width), in left to right order,
+// leaving out empty ones. Returns the number of spans.
+int get_bar_spans(int width, int x, struct span_t spans[MAX_BAR_SPANS]);
+
+// Returns data->x for a window of the given width, which may not be the one
+// the sweep was last updated for if the window has just been resized.
+guint get_pattern_x(const struct data_t *data, int width);
+// Draws data's pattern at data->x across the whole of cr's clip, for a
+// width x height window. For a pattern that scrolls, this paints a cached
+// row, which is (re-)rendered first if width has changed.
+void draw_pattern(struct data_t *data, cairo_t *cr, int width, int height);
+void free_bar_cache(struct data_t *data);
+
+// Runs the headless render benchmark and returns an exit code.
+int run_bench(void);
+// Checks the rendering code against reference implementations, prints the
+// results and returns an exit code.
+int run_self_test(void);
+
+// Parameters of a session simulated in virtual time.
+struct simulation_t {
+  double hours;
+  const struct pattern_t *pattern;
+  int max_fps;
+  // Percentage of frames after which the main loop stalls for a few
+  // refreshes.
+  double slow_frame_percent;
+  // Minutes between resizes, which rotate the screen, or 0 for none.
+  int resize_minutes;
+};
+
+// Sweeps a headless screen against a virtual clock, as fast as possible, and
+// prints how long each column was covered by the bar along with the frame
+// statistics. Returns an exit code.
+int run_simulation(const struct simulation_t *simulation);
+
+// Asks the Wayland compositor not to blank the screen while window is
+// visible. Returns FALSE if it is not on a Wayland display or the compositor
+// doesn't support idle inhibition.
+gboolean wayland_inhibit_idle(GtkWidget *window);
+void wayland_uninhibit_idle(void);
+
+#endif  // PLASMACLEANER_H_
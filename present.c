@@ -0,0 +1,264 @@
+// Backend that draws into pixmaps and flips them onto the screen with the X
+// Present extension, which reports when each frame really reached the screen.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xpresent.h>
+
+#include "x11.h"
+
+// One pixmap may be on screen, one queued for the next refresh and one being
+// drawn.
+#define PRESENT_PIXMAPS 3
+
+// Size in bytes of a PresentPixmap request without notifies.
+#define X11_PRESENT_PIXMAP_BYTES 72
+
+struct present_pixmap_t {
+  Pixmap pixmap;
+  // Set from PresentPixmap until the server's PresentIdleNotify.
+  gboolean busy;
+  // The PresentPixmap request's serial, when it was made (in microseconds)
+  // and the refresh it targeted.
+  guint32 serial;
+  gint64 submit_time;
+  guint64 target_msc;
+};
+
+struct present_t {
+  struct x11_window_t xw;
+  // The pattern's colours.
+  GC gcs[MAX_PATTERN_COLOURS];
+  int opcode;
+  XID event_id;
+  struct present_pixmap_t pixmaps[PRESENT_PIXMAPS];
+  int pixmap_width;
+  int pixmap_height;
+  guint32 serial;
+  // The refresh targeted by the last frame, or 0 before the first.
+  guint64 last_target_msc;
+};
+
+static struct present_pixmap_t *find_pixmap_by_serial(
+    struct present_t *present, guint32 serial) {
+  for (int i = 0; i < PRESENT_PIXMAPS; ++i) {
+    if (present->pixmaps[i].pixmap && present->pixmaps[i].serial == serial) {
+      return &present->pixmaps[i];
+    }
+  }
+  return NULL;
+}
+
+static void on_complete(struct present_t *present,
+    const XPresentCompleteNotifyEvent *complete) {
+  struct data_t *data = present->xw.data;
+  struct present_pixmap_t *pixmap = find_pixmap_by_serial(present,
+      complete->serial_number);
+  if (complete->kind != PresentCompleteKindPixmap || !pixmap) {
+    return;
+  }
+  if (complete->mode == PresentCompleteModeSkip) {
+    stats_record_present(&data->stats, 0, FALSE, TRUE);
+    return;
+  }
+  // On Linux, UST is CLOCK_MONOTONIC in microseconds, like frame times.
+  gint64 ust = (gint64)complete->ust;
+  stats_record_present(&data->stats, (ust - pixmap->submit_time) * 1000,
+      pixmap->target_msc && complete->msc > pixmap->target_msc, FALSE);
+  if (data->present_time && complete->msc > data->present_msc) {
+    data->present_interval = (ust - data->present_time) /
+        (gint64)(complete->msc - data->present_msc);
+  }
+  data->present_time = ust;
+  data->present_msc = complete->msc;
+}
+
+static void on_idle(struct present_t *present,
+    const XPresentIdleNotifyEvent *idle) {
+  for (int i = 0; i < PRESENT_PIXMAPS; ++i) {
+    if (present->pixmaps[i].pixmap == idle->pixmap) {
+      present->pixmaps[i].busy = FALSE;
+    }
+  }
+}
+
+static GdkFilterReturn on_present_event(GdkXEvent *gdk_xevent,
+    GdkEvent *event, gpointer user_data) {
+  struct present_t *present = (struct present_t *)user_data;
+  XEvent *xevent = (XEvent *)gdk_xevent;
+  XGenericEventCookie *cookie = &xevent->xcookie;
+  if (xevent->type != GenericEvent ||
+      cookie->extension != present->opcode) {
+    return GDK_FILTER_CONTINUE;
+  }
+  // GDK normally fetches the event data before running filters.
+  gboolean fetched = FALSE;
+  if (!cookie->data) {
+    if (!XGetEventData(present->xw.display, cookie)) {
+      return GDK_FILTER_CONTINUE;
+    }
+    fetched = TRUE;
+  }
+  GdkFilterReturn result = GDK_FILTER_CONTINUE;
+  switch (cookie->evtype) {
+    case PresentCompleteNotify: {
+      const XPresentCompleteNotifyEvent *complete = cookie->data;
+      if (complete->window == present->xw.window) {
+        on_complete(present, complete);
+        result = GDK_FILTER_REMOVE;
+      }
+      break;
+    }
+    case PresentIdleNotify: {
+      const XPresentIdleNotifyEvent *idle = cookie->data;
+      if (idle->window == present->xw.window) {
+        on_idle(present, idle);
+        result = GDK_FILTER_REMOVE;
+      }
+      break;
+    }
+  }
+  if (fetched) {
+    XFreeEventData(present->xw.display, cookie);
+  }
+  return result;
+}
+
+static void free_pixmaps(struct present_t *present) {
+  for (int i = 0; i < PRESENT_PIXMAPS; ++i) {
+    if (present->pixmaps[i].pixmap) {
+      // The server keeps the pixmap until it is done presenting it.
+      XFreePixmap(present->xw.display, present->pixmaps[i].pixmap);
+    }
+  }
+  memset(present->pixmaps, 0, sizeof(present->pixmaps));
+}
+
+// (Re-)creates the pixmaps if the window size has changed.
+static void update_pixmaps(struct present_t *present) {
+  struct x11_window_t *xw = &present->xw;
+  if (present->pixmaps[0].pixmap && present->pixmap_width == xw->width &&
+      present->pixmap_height == xw->height) {
+    return;
+  }
+  free_pixmaps(present);
+  for (int i = 0; i < PRESENT_PIXMAPS; ++i) {
+    present->pixmaps[i].pixmap = XCreatePixmap(xw->display, xw->window,
+        xw->width, xw->height, xw->depth);
+  }
+  present->pixmap_width = xw->width;
+  present->pixmap_height = xw->height;
+}
+
+static void present_destroy(struct data_t *data) {
+  struct present_t *present = (struct present_t *)data->backend_data;
+  if (!present) {
+    return;
+  }
+  if (present->xw.window) {
+    gdk_window_remove_filter(NULL, &on_present_event, present);
+    if (present->event_id) {
+      XPresentFreeInput(present->xw.display, present->xw.window,
+          present->event_id);
+    }
+    free_pixmaps(present);
+    if (present->gcs[0]) {
+      x11_free_pattern_gcs(&present->xw, data->pattern, present->gcs);
+    }
+    x11_window_destroy(&present->xw);
+  }
+  // Feedback from a window that no longer exists is meaningless.
+  data->present_interval = 0;
+  g_free(present);
+  data->backend_data = NULL;
+}
+
+static gboolean present_init(struct data_t *data) {
+  struct present_t *present = g_new0(struct present_t, 1);
+  data->backend_data = present;
+  if (!x11_window_init(&present->xw, data)) {
+    present_destroy(data);
+    return FALSE;
+  }
+  struct x11_window_t *xw = &present->xw;
+  int event_base, error_base;
+  if (!XPresentQueryExtension(xw->display, &present->opcode, &event_base,
+      &error_base)) {
+    g_printerr("The X server does not support Present\n");
+    present_destroy(data);
+    return FALSE;
+  }
+  x11_create_pattern_gcs(xw, data->pattern, present->gcs);
+  present->event_id = XPresentSelectInput(xw->display, xw->window,
+      PresentCompleteNotifyMask|PresentIdleNotifyMask);
+  gdk_window_add_filter(NULL, &on_present_event, present);
+  return TRUE;
+}
+
+static void present_update(struct data_t *data, int old_x, gboolean full) {
+  struct present_t *present = (struct present_t *)data->backend_data;
+  struct x11_window_t *xw = &present->xw;
+  x11_window_update_size(xw);
+  update_pixmaps(present);
+
+  struct present_pixmap_t *pixmap = NULL;
+  for (int i = 0; i < PRESENT_PIXMAPS && !pixmap; ++i) {
+    if (!present->pixmaps[i].busy) {
+      pixmap = &present->pixmaps[i];
+    }
+  }
+  if (!pixmap) {
+    // Every pixmap is on screen or queued, so drop the frame and try again
+    // on the next tick.
+    ++data->stats.dropped_frames;
+    data->damaged = TRUE;
+    return;
+  }
+
+  XRectangle clip = { 0, 0, xw->width, xw->height };
+  data->stats.x11_request_bytes += x11_fill_frame(xw, pixmap->pixmap,
+      present->gcs, &data->program.frame, &clip);
+
+  // Flip at the refresh the sweep was computed for. Until there is feedback,
+  // target 0, which means the next refresh.
+  guint64 target_msc = 0;
+  if (data->present_interval) {
+    target_msc = MAX(data->next_present_msc, present->last_target_msc + 1);
+  }
+  XPresentPixmap(xw->display, xw->window, pixmap->pixmap, ++present->serial,
+      None, None, 0, 0, None, None, None, PresentOptionNone, target_msc, 0, 0,
+      NULL, 0);
+  data->stats.x11_request_bytes += X11_PRESENT_PIXMAP_BYTES;
+  pixmap->busy = TRUE;
+  pixmap->serial = present->serial;
+  pixmap->submit_time = g_get_monotonic_time();
+  pixmap->target_msc = target_msc;
+  present->last_target_msc = target_msc;
+  XFlush(xw->display);
+}
+
+const struct backend_t PRESENT_BACKEND = {
+  "present",
+  "draw into pixmaps and flip them at vblank with the Present extension",
+  &present_init,
+  &present_update,
+  &present_destroy,
+  FALSE,
+};
@@ -0,0 +1,98 @@
+// Real-time settings.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+// For CPU_SET() and pthread_setaffinity_np().
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "realtime.h"
+
+// Timer slack in nanoseconds. The kernel's default is 50 us, which is a
+// noticeable fraction of a frame; it can't be 0, which means the default.
+static const unsigned long TIMER_SLACK_NS = 1;
+
+gboolean realtime_parse_policy(const char *name, int *policy) {
+  if (!strcmp(name, "fifo")) {
+    *policy = SCHED_FIFO;
+  } else if (!strcmp(name, "rr")) {
+    *policy = SCHED_RR;
+  } else {
+    return FALSE;
+  }
+  return TRUE;
+}
+
+gboolean realtime_apply(const struct realtime_t *rt, const char *thread) {
+  gboolean applied = TRUE;
+  if (prctl(PR_SET_TIMERSLACK, TIMER_SLACK_NS, 0, 0, 0) < 0) {
+    g_printerr("Cannot reduce the timer slack of the %s thread: %s\n",
+        thread, g_strerror(errno));
+    applied = FALSE;
+  }
+  if (rt->policy != SCHED_OTHER) {
+    struct sched_param param = { .sched_priority = rt->priority };
+    int error = pthread_setschedparam(pthread_self(), rt->policy, &param);
+    if (error) {
+      g_printerr("Cannot use %s for the %s thread (%s); using normal "
+          "priority\n", rt->policy == SCHED_RR ? "SCHED_RR" : "SCHED_FIFO",
+          thread, g_strerror(error));
+      applied = FALSE;
+    }
+  }
+  if (rt->cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    int error = EINVAL;
+    if (rt->cpu < CPU_SETSIZE) {
+      CPU_SET(rt->cpu, &cpus);
+      error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+    if (error) {
+      g_printerr("Cannot pin the %s thread to CPU %d: %s\n", thread, rt->cpu,
+          g_strerror(error));
+      applied = FALSE;
+    }
+  }
+  return applied;
+}
+
+gboolean realtime_lock_memory(void) {
+  // Future mappings are locked too, but only if the limit can't make them
+  // fail (e.g. when a resize reallocates the frame buffers).
+  int flags = MCL_CURRENT;
+  struct rlimit limit;
+  if (geteuid() == 0 || (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 &&
+      limit.rlim_cur == RLIM_INFINITY)) {
+    flags |= MCL_FUTURE;
+  }
+  if (mlockall(flags) < 0) {
+    g_printerr("Cannot lock memory (%s); raise RLIMIT_MEMLOCK or grant "
+        "CAP_IPC_LOCK\n", g_strerror(errno));
+    return FALSE;
+  }
+  return TRUE;
+}
@@ -0,0 +1,47 @@
+// Real-time scheduling, memory locking and CPU pinning for the frame path.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#ifndef REALTIME_H_
+#define REALTIME_H_
+
+#include <glib.h>
+
+// How to schedule a thread on the frame path.
+struct realtime_t {
+  // SCHED_FIFO or SCHED_RR, or SCHED_OTHER to leave the policy alone.
+  int policy;
+  int priority;
+  // CPU to pin to, or -1 to leave the affinity alone.
+  int cpu;
+};
+
+// Parses "fifo" or "rr" into a policy. Returns FALSE if name is neither.
+gboolean realtime_parse_policy(const char *name, int *policy);
+
+// Applies rt to the calling thread, and minimises its timer slack so that
+// timers wake it on time even where the policy can't be changed. Prints a
+// warning naming thread for each setting that isn't permitted, and returns
+// whether all of them applied.
+gboolean realtime_apply(const struct realtime_t *rt, const char *thread);
+
+// Locks the process's memory so that page faults can't stall a frame.
+// Prints a warning and returns FALSE if that isn't permitted.
+gboolean realtime_lock_memory(void);
+
+#endif  // REALTIME_H_
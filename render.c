@@ -0,0 +1,122 @@
+// Cairo rendering of the bar, shared by the window and the benchmark.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include "plasmacleaner.h"
+
+// Fills the spans of frame with their colours, one path per colour.
+static void fill_frame(cairo_t *cr, const struct pattern_t *pattern,
+    const struct pattern_frame_t *frame) {
+  for (int colour = 0; colour < pattern->n_colours; ++colour) {
+    for (int i = 0; i < frame->n_bands; ++i) {
+      const struct band_t *band = &frame->bands[i];
+      for (int j = 0; j < band->n_spans; ++j) {
+        if (band->spans[j].colour == colour) {
+          cairo_rectangle(cr, band->spans[j].x, band->y, band->spans[j].len,
+              band->height);
+        }
+      }
+    }
+    const struct colour_t *c = &pattern->colours[colour];
+    cairo_set_source_rgb(cr, c->r, c->g, c->b);
+    cairo_fill(cr);
+  }
+}
+
+// (Re-)renders the cached row if the width has changed. The row is created
+// similar to cr's target so that, e.g., on X11 it lives server-side.
+static void update_bar_cache(struct data_t *data, cairo_t *cr, int width) {
+  if (data->bar_pattern && data->bar_width == width) {
+    return;
+  }
+  if (data->bar_pattern) {
+    cairo_pattern_destroy(data->bar_pattern);
+  }
+
+  cairo_surface_t *surface = cairo_surface_create_similar(cairo_get_target(cr),
+      CAIRO_CONTENT_COLOR, width, 1);
+  cairo_t *surface_cr = cairo_create(surface);
+  const struct band_t band = { 0, 1, data->program.row, data->program.n_row };
+  const struct pattern_frame_t row = { &band, 1 };
+  fill_frame(surface_cr, data->pattern, &row);
+  cairo_destroy(surface_cr);
+
+  data->bar_pattern = cairo_pattern_create_for_surface(surface);
+  cairo_surface_destroy(surface);
+  cairo_pattern_set_extend(data->bar_pattern, CAIRO_EXTEND_REPEAT);
+  cairo_pattern_set_filter(data->bar_pattern, CAIRO_FILTER_NEAREST);
+  data->bar_width = width;
+}
+
+guint get_pattern_x(const struct data_t *data, int width) {
+  if (!data->sweep_width || data->sweep_width == width) {
+    return data->x;
+  }
+  return (guint)((guint64)data->x * width / data->sweep_width);
+}
+
+void draw_pattern(struct data_t *data, cairo_t *cr, int width, int height) {
+  guint x = get_pattern_x(data, width);
+  span_program_compile(&data->program, data->pattern, width, height);
+  if (!data->pattern->scrolls) {
+    fill_frame(cr, data->pattern, span_program_run(&data->program, x));
+    return;
+  }
+  update_bar_cache(data, cr, width);
+  cairo_matrix_t matrix;
+  cairo_matrix_init_translate(&matrix, -(double)x, 0.0);
+  cairo_pattern_set_matrix(data->bar_pattern, &matrix);
+  cairo_set_source(cr, data->bar_pattern);
+  cairo_paint(cr);
+}
+
+void free_bar_cache(struct data_t *data) {
+  if (data->bar_pattern) {
+    cairo_pattern_destroy(data->bar_pattern);
+    data->bar_pattern = NULL;
+  }
+}
+
+int get_bar_width(int width) {
+  return (int)(BAR_FRACTION * width + 0.5);
+}
+
+int get_bar_spans(int width, int x, struct span_t spans[MAX_BAR_SPANS]) {
+  int n = 0;
+  int end = x + get_bar_width(width);
+  if (end <= width) {
+    if (x > 0) {
+      spans[n++] = (struct span_t){ 0, x, 0 };
+    }
+    // The bar rounds to nothing on a narrow enough screen.
+    if (end > x) {
+      spans[n++] = (struct span_t){ x, end - x, 1 };
+    }
+    if (end < width) {
+      spans[n++] = (struct span_t){ end, width - end, 0 };
+    }
+  } else {
+    // The bar wraps around the right edge, and may cover the whole row.
+    spans[n++] = (struct span_t){ 0, end - width, 1 };
+    if (x > end - width) {
+      spans[n++] = (struct span_t){ end - width, x - (end - width), 0 };
+    }
+    spans[n++] = (struct span_t){ x, width - x, 1 };
+  }
+  return n;
+}
@@ -0,0 +1,209 @@
+// Thread pool that renders horizontal bands of a frame in parallel.
+//
+// Each frame is cut into bands of BAND_ROWS rows, which are dealt out to the
+// threads as contiguous ranges. A thread takes bands from the front of its
+// own range and, once that is empty, steals from the back of the others.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include "render_pool.h"
+
+// Rows per band. Small enough to balance load, large enough that the
+// per-band overhead doesn't matter.
+#define BAND_ROWS 32
+
+struct worker_t {
+  struct render_pool_t *pool;
+  GThread *thread;
+  // Remaining bands [next, end), packed as next | end << 32 so that both
+  // ends can be claimed with a single compare-and-swap.
+  guint64 range;
+} __attribute__((aligned(64)));
+
+struct render_pool_t {
+  int threads;
+  struct worker_t *workers;
+  // Scheduling for the worker threads, if has_rt.
+  gboolean has_rt;
+  struct realtime_t rt;
+
+  GMutex mutex;
+  GCond start_cond;
+  GCond done_cond;
+  // Incremented for each frame; workers wait for it to change.
+  guint64 generation;
+  gboolean quit;
+  // Workers still rendering the current frame.
+  int busy;
+
+  // The current frame.
+  int height;
+  render_band_func_t func;
+  gpointer user_data;
+};
+
+static guint64 pack_range(guint32 next, guint32 end) {
+  return (guint64)next | (guint64)end << 32;
+}
+
+// Claims the band at the front (if front is TRUE) or the back of a worker's
+// range. Returns the band's index or -1 if the range is empty.
+static int claim_band(struct worker_t *worker, gboolean front) {
+  guint64 range = __atomic_load_n(&worker->range, __ATOMIC_ACQUIRE);
+  for (;;) {
+    guint32 next = (guint32)range;
+    guint32 end = (guint32)(range >> 32);
+    if (next >= end) {
+      return -1;
+    }
+    guint64 claimed = front ? pack_range(next + 1, end) :
+        pack_range(next, end - 1);
+    if (__atomic_compare_exchange_n(&worker->range, &range, claimed, FALSE,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      return front ? (int)next : (int)end - 1;
+    }
+  }
+}
+
+static void render_band(struct render_pool_t *pool, int band) {
+  int y = band * BAND_ROWS;
+  pool->func(pool->user_data, y, MIN(BAND_ROWS, pool->height - y));
+}
+
+static void run_worker(struct worker_t *worker) {
+  struct render_pool_t *pool = worker->pool;
+  int band;
+  while ((band = claim_band(worker, TRUE)) >= 0) {
+    render_band(pool, band);
+  }
+  // Steal from the others, starting with the next worker so that thieves
+  // spread out.
+  int self = (int)(worker - pool->workers);
+  for (int i = 1; i < pool->threads; ++i) {
+    struct worker_t *victim = &pool->workers[(self + i) % pool->threads];
+    while ((band = claim_band(victim, FALSE)) >= 0) {
+      render_band(pool, band);
+    }
+  }
+}
+
+static gpointer worker_thread(gpointer user_data) {
+  struct worker_t *worker = (struct worker_t *)user_data;
+  struct render_pool_t *pool = worker->pool;
+  if (pool->has_rt) {
+    realtime_apply(&pool->rt, "render pool");
+  }
+  guint64 generation = 0;
+  for (;;) {
+    g_mutex_lock(&pool->mutex);
+    while (!pool->quit && pool->generation == generation) {
+      g_cond_wait(&pool->start_cond, &pool->mutex);
+    }
+    if (pool->quit) {
+      g_mutex_unlock(&pool->mutex);
+      return NULL;
+    }
+    generation = pool->generation;
+    g_mutex_unlock(&pool->mutex);
+
+    run_worker(worker);
+
+    g_mutex_lock(&pool->mutex);
+    if (!--pool->busy) {
+      g_cond_signal(&pool->done_cond);
+    }
+    g_mutex_unlock(&pool->mutex);
+  }
+}
+
+struct render_pool_t *render_pool_new(int threads,
+    const struct realtime_t *rt) {
+  struct render_pool_t *pool = g_new0(struct render_pool_t, 1);
+  pool->threads = threads > 0 ? threads : (int)g_get_num_processors();
+  if (rt) {
+    // Pinning every worker to the caller's CPU would serialise them.
+    pool->has_rt = TRUE;
+    pool->rt = *rt;
+    pool->rt.cpu = -1;
+  }
+  pool->workers = g_new0(struct worker_t, pool->threads);
+  g_mutex_init(&pool->mutex);
+  g_cond_init(&pool->start_cond);
+  g_cond_init(&pool->done_cond);
+  // Worker 0 is the calling thread.
+  for (int i = 0; i < pool->threads; ++i) {
+    pool->workers[i].pool = pool;
+    if (i) {
+      pool->workers[i].thread = g_thread_new("render", &worker_thread,
+          &pool->workers[i]);
+    }
+  }
+  return pool;
+}
+
+void render_pool_free(struct render_pool_t *pool) {
+  g_mutex_lock(&pool->mutex);
+  pool->quit = TRUE;
+  g_cond_broadcast(&pool->start_cond);
+  g_mutex_unlock(&pool->mutex);
+  for (int i = 1; i < pool->threads; ++i) {
+    g_thread_join(pool->workers[i].thread);
+  }
+  g_cond_clear(&pool->done_cond);
+  g_cond_clear(&pool->start_cond);
+  g_mutex_clear(&pool->mutex);
+  g_free(pool->workers);
+  g_free(pool);
+}
+
+int render_pool_get_threads(const struct render_pool_t *pool) {
+  return pool->threads;
+}
+
+void render_pool_run(struct render_pool_t *pool, int height,
+    render_band_func_t func, gpointer user_data) {
+  if (pool->threads == 1) {
+    func(user_data, 0, height);
+    return;
+  }
+
+  int bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+  pool->height = height;
+  pool->func = func;
+  pool->user_data = user_data;
+  for (int i = 0; i < pool->threads; ++i) {
+    guint32 start = (guint32)((gint64)bands * i / pool->threads);
+    guint32 end = (guint32)((gint64)bands * (i + 1) / pool->threads);
+    __atomic_store_n(&pool->workers[i].range, pack_range(start, end),
+        __ATOMIC_RELAXED);
+  }
+
+  g_mutex_lock(&pool->mutex);
+  pool->busy = pool->threads - 1;
+  ++pool->generation;
+  g_cond_broadcast(&pool->start_cond);
+  g_mutex_unlock(&pool->mutex);
+
+  run_worker(&pool->workers[0]);
+
+  g_mutex_lock(&pool->mutex);
+  while (pool->busy) {
+    g_cond_wait(&pool->done_cond, &pool->mutex);
+  }
+  g_mutex_unlock(&pool->mutex);
+}
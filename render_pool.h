@@ -0,0 +1,46 @@
+// Thread pool that renders horizontal bands of a frame in parallel.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#ifndef RENDER_POOL_H_
+#define RENDER_POOL_H_
+
+#include <glib.h>
+
+#include "realtime.h"
+
+struct render_pool_t;
+
+// Renders rows [y, y + height) of a frame.
+typedef void (*render_band_func_t)(gpointer user_data, int y, int height);
+
+// Creates a pool that renders with the given number of threads, including
+// the calling thread. 0 means one per processor. If rt isn't NULL, the other
+// threads are scheduled with its policy (but not pinned to its CPU), so that
+// a real-time caller doesn't wait on them.
+struct render_pool_t *render_pool_new(int threads,
+    const struct realtime_t *rt);
+void render_pool_free(struct render_pool_t *pool);
+int render_pool_get_threads(const struct render_pool_t *pool);
+
+// Calls func for bands covering rows [0, height) from all threads and
+// returns once every band has been rendered.
+void render_pool_run(struct render_pool_t *pool, int height,
+    render_band_func_t func, gpointer user_data);
+
+#endif  // RENDER_POOL_H_
@@ -0,0 +1,120 @@
+// Backend that scrolls the window contents on the X server and only paints
+// the columns that scroll in at the left edge.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include "x11.h"
+
+struct scroll_t {
+  struct x11_window_t xw;
+  // For XCopyArea, with graphics exposures so that we hear about areas that
+  // could not be copied.
+  GC copy_gc;
+  // The pattern's colours.
+  GC fill_gcs[MAX_PATTERN_COLOURS];
+};
+
+// Paints columns [clip_x, clip_x + clip_width) of the current frame.
+static size_t draw_columns(struct scroll_t *scroll, int clip_x,
+    int clip_width) {
+  struct x11_window_t *xw = &scroll->xw;
+  XRectangle clip = { clip_x, 0, clip_width, xw->height };
+  return x11_fill_frame(xw, xw->window, scroll->fill_gcs,
+      &xw->data->program.frame, &clip);
+}
+
+static GdkFilterReturn on_scroll_event(GdkXEvent *gdk_xevent, GdkEvent *event,
+    gpointer user_data) {
+  struct scroll_t *scroll = (struct scroll_t *)user_data;
+  XEvent *xevent = (XEvent *)gdk_xevent;
+  switch (xevent->type) {
+    case GraphicsExpose:
+      if (xevent->xgraphicsexpose.drawable != scroll->xw.window) {
+        return GDK_FILTER_CONTINUE;
+      }
+      // Part of the window was obscured, so what we copied is wrong.
+      scroll->xw.data->damaged = TRUE;
+      return GDK_FILTER_REMOVE;
+    case NoExpose:
+      return xevent->xnoexpose.drawable == scroll->xw.window ?
+          GDK_FILTER_REMOVE : GDK_FILTER_CONTINUE;
+    default:
+      return GDK_FILTER_CONTINUE;
+  }
+}
+
+static void scroll_destroy(struct data_t *data) {
+  struct scroll_t *scroll = (struct scroll_t *)data->backend_data;
+  if (!scroll) {
+    return;
+  }
+  if (scroll->xw.window) {
+    gdk_window_remove_filter(NULL, &on_scroll_event, scroll);
+    XFreeGC(scroll->xw.display, scroll->copy_gc);
+    x11_free_pattern_gcs(&scroll->xw, data->pattern, scroll->fill_gcs);
+    x11_window_destroy(&scroll->xw);
+  }
+  g_free(scroll);
+  data->backend_data = NULL;
+}
+
+static gboolean scroll_init(struct data_t *data) {
+  struct scroll_t *scroll = g_new0(struct scroll_t, 1);
+  data->backend_data = scroll;
+  if (!x11_window_init(&scroll->xw, data)) {
+    scroll_destroy(data);
+    return FALSE;
+  }
+  XGCValues values;
+  values.graphics_exposures = True;
+  scroll->copy_gc = XCreateGC(scroll->xw.display, scroll->xw.window,
+      GCGraphicsExposures, &values);
+  x11_create_pattern_gcs(&scroll->xw, data->pattern, scroll->fill_gcs);
+  gdk_window_add_filter(NULL, &on_scroll_event, scroll);
+  return TRUE;
+}
+
+static void scroll_update(struct data_t *data, int old_x, gboolean full) {
+  struct scroll_t *scroll = (struct scroll_t *)data->backend_data;
+  struct x11_window_t *xw = &scroll->xw;
+  x11_window_update_size(xw);
+  int width = xw->width;
+
+  int dx = (((int)data->x - old_x) % width + width) % width;
+  // A pattern that doesn't scroll has to be painted afresh every frame.
+  if (full || dx > width / 2 || !data->pattern->scrolls) {
+    data->stats.x11_request_bytes += draw_columns(scroll, 0, width);
+  } else if (dx) {
+    // Everything moves right by dx, and what falls off the right edge comes
+    // back in on the left.
+    XCopyArea(xw->display, xw->window, xw->window, scroll->copy_gc, 0, 0,
+        width - dx, xw->height, dx, 0);
+    data->stats.x11_request_bytes += X11_COPY_AREA_BYTES +
+        draw_columns(scroll, 0, dx);
+  }
+  XFlush(xw->display);
+}
+
+const struct backend_t SCROLL_BACKEND = {
+  "scroll",
+  "scroll the window contents on the X server and paint only the new columns",
+  &scroll_init,
+  &scroll_update,
+  &scroll_destroy,
+  FALSE,
+};
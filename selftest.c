@@ -0,0 +1,400 @@
+// Self-tests of the rendering code against simple reference implementations.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "plasmacleaner.h"
+#include "render_pool.h"
+#include "spanfill.h"
+
+// Spans are checked at every start from 0 to SPANFILL_CHECK_MAX_X, to cover
+// every alignment the kernels handle, and with every length up to
+// SPANFILL_CHECK_DENSE_LEN and then every SPANFILL_CHECK_LEN_STEP-th length
+// up to SPANFILL_CHECK_MAX_LEN, which is past the non-temporal threshold in
+// every format. The pixels after a span must be left alone up to
+// SPANFILL_CHECK_MARGIN.
+static const int SPANFILL_CHECK_MAX_X = 64;
+static const int SPANFILL_CHECK_DENSE_LEN = 300;
+static const int SPANFILL_CHECK_LEN_STEP = 7;
+static const int SPANFILL_CHECK_MAX_LEN = 1200;
+static const int SPANFILL_CHECK_MARGIN = 16;
+// What each byte of the buffer is set to before each span.
+static const int SPANFILL_CHECK_GUARD = 0xa5;
+
+// Returns the pixel at index i of a row in the given format.
+static guint32 get_pixel(const guint8 *row, enum pixel_format_t format,
+    int i) {
+  if (pixel_format_get_bytes(format) == 2) {
+    return ((const guint16 *)row)[i];
+  }
+  return ((const guint32 *)row)[i];
+}
+
+// Fills one span with the given kernel at every start and length, and
+// compares each pixel with what it should be.
+static gboolean check_spanfill_kernel(const struct spanfill_kernel_t *kernel,
+    enum pixel_format_t format, guint8 *buffer) {
+  int bytes = pixel_format_get_bytes(format);
+  guint32 guard = bytes == 2 ? 0xa5a5 : 0xa5a5a5a5;
+  guint32 palette[1] = { pixel_format_pack(format, 0.25, 0.5, 0.75) };
+  spanfill_set_kernel(kernel);
+  for (int x = 0; x <= SPANFILL_CHECK_MAX_X; ++x) {
+    for (int len = 0; len <= SPANFILL_CHECK_MAX_LEN;
+        len += len < SPANFILL_CHECK_DENSE_LEN ? 1 : SPANFILL_CHECK_LEN_STEP) {
+      int end = x + len + SPANFILL_CHECK_MARGIN;
+      memset(buffer, SPANFILL_CHECK_GUARD, (size_t)end * bytes);
+      struct span_t span = { x, len, 0 };
+      spanfill_rows(buffer, end * bytes, format, 0, 1, &span, 1, palette);
+      for (int i = 0; i < end; ++i) {
+        guint32 expected = i >= x && i < x + len ? palette[0] : guard;
+        guint32 actual = get_pixel(buffer, format, i);
+        if (actual != expected) {
+          g_print("spanfill: FAILED: %s kernel, %s, span [%d, %d): pixel %d "
+              "is 0x%x, expected 0x%x\n", kernel->name,
+              pixel_format_get_name(format), x, x + len, i, actual,
+              expected);
+          return FALSE;
+        }
+      }
+    }
+  }
+  return TRUE;
+}
+
+// Checks every kernel the CPU supports in every format.
+static gboolean check_spanfill(void) {
+  static const enum pixel_format_t FORMATS[] = {
+    PIXEL_FORMAT_X8R8G8B8,
+    PIXEL_FORMAT_R5G6B5,
+    PIXEL_FORMAT_A2R10G10B10,
+  };
+  guint8 *buffer = g_malloc((size_t)(SPANFILL_CHECK_MAX_X +
+      SPANFILL_CHECK_MAX_LEN + SPANFILL_CHECK_MARGIN) * 4);
+  int n;
+  const struct spanfill_kernel_t *const *kernels = spanfill_get_kernels(&n);
+  gboolean ok = TRUE;
+  for (int i = 0; i < n && ok; ++i) {
+    for (size_t j = 0; j < G_N_ELEMENTS(FORMATS) && ok; ++j) {
+      ok = check_spanfill_kernel(kernels[i], FORMATS[j], buffer);
+    }
+  }
+  spanfill_set_kernel(spanfill_get_best_kernel());
+  g_free(buffer);
+  if (ok) {
+    g_print("spanfill: ok (%d kernels, %d formats)\n", n,
+        (int)G_N_ELEMENTS(FORMATS));
+  }
+  return ok;
+}
+
+// Frame heights the render pool is checked with: less than a band, around a
+// band boundary, and real screens.
+static const int RENDER_POOL_CHECK_HEIGHTS[] = {
+  1, 31, 32, 33, 100, 1081, 2160, 3840,
+};
+static const int RENDER_POOL_CHECK_FRAMES = 200;
+// The pool is checked with up to this many threads even on smaller
+// machines, so that there is always stealing to check.
+static const int RENDER_POOL_CHECK_MIN_THREADS = 4;
+
+struct render_pool_check_t {
+  int height;
+  // How many times each row has been rendered this frame.
+  gint *rendered;
+  // Set if a band fell outside the frame.
+  gint out_of_range;
+};
+
+static void render_check_band(gpointer user_data, int y, int height) {
+  struct render_pool_check_t *check = (struct render_pool_check_t *)user_data;
+  if (y < 0 || height <= 0 || y + height > check->height) {
+    g_atomic_int_set(&check->out_of_range, TRUE);
+    return;
+  }
+  for (int row = y; row < y + height; ++row) {
+    g_atomic_int_inc(&check->rendered[row]);
+  }
+  // Make some bands much slower than others, so that threads run out of
+  // their own and steal.
+  volatile int n = 0;
+  for (int i = 0; i < y % 97 * 100; ++i) {
+    ++n;
+  }
+}
+
+// Renders frames of each height with each thread count, and checks that
+// every row is rendered exactly once.
+static gboolean check_render_pool(void) {
+  // One more thread than CPUs, so that some worker is always preempted.
+  int max_threads = MAX((int)g_get_num_processors() + 1,
+      RENDER_POOL_CHECK_MIN_THREADS);
+  int max_height = 0;
+  for (size_t i = 0; i < G_N_ELEMENTS(RENDER_POOL_CHECK_HEIGHTS); ++i) {
+    max_height = MAX(max_height, RENDER_POOL_CHECK_HEIGHTS[i]);
+  }
+  struct render_pool_check_t check;
+  check.rendered = g_new(gint, max_height);
+  gboolean ok = TRUE;
+  for (int threads = 1; threads <= max_threads && ok; ++threads) {
+    struct render_pool_t *pool = render_pool_new(threads, NULL);
+    for (size_t i = 0; i < G_N_ELEMENTS(RENDER_POOL_CHECK_HEIGHTS) && ok;
+        ++i) {
+      check.height = RENDER_POOL_CHECK_HEIGHTS[i];
+      for (int frame = 0; frame < RENDER_POOL_CHECK_FRAMES && ok; ++frame) {
+        memset(check.rendered, 0, sizeof(gint) * check.height);
+        check.out_of_range = FALSE;
+        render_pool_run(pool, check.height, &render_check_band, &check);
+        if (check.out_of_range) {
+          g_print("render pool: FAILED: %d threads, height %d: band outside "
+              "the frame\n", threads, check.height);
+          ok = FALSE;
+        }
+        for (int row = 0; row < check.height && ok; ++row) {
+          if (check.rendered[row] != 1) {
+            g_print("render pool: FAILED: %d threads, height %d: row %d "
+                "rendered %d times\n", threads, check.height, row,
+                check.rendered[row]);
+            ok = FALSE;
+          }
+        }
+      }
+    }
+    render_pool_free(pool);
+  }
+  g_free(check.rendered);
+  if (ok) {
+    g_print("render pool: ok (1 to %d threads)\n", max_threads);
+  }
+  return ok;
+}
+
+// The sweep is checked with frame times jittered by up to
+// SWEEP_CHECK_JITTER_US either way, on a window as wide as a 4K screen. On a
+// 60 Hz display the bar moves 16 pixels a frame. On a 144 Hz display capped
+// to SWEEP_CHECK_MAX_FPS it is drawn on every third refresh and moves 19.999
+// pixels a frame, so the position sits on a pixel boundary for long enough
+// that jitter makes steps a pixel off either way. Halfway through one of the
+// 60 Hz runs, the window shrinks to SWEEP_CHECK_RESIZED_WIDTH between two
+// frames.
+static const int SWEEP_CHECK_WIDTH = 3840;
+static const int SWEEP_CHECK_RESIZED_WIDTH = 1920;
+static const gint64 SWEEP_CHECK_INTERVAL_US = 16667;
+static const gint64 SWEEP_CHECK_FAST_INTERVAL_US = 6944;
+static const int SWEEP_CHECK_MAX_FPS = 60;
+static const gint64 SWEEP_CHECK_JITTER_US = 1000;
+// The bar wraps this many times, half a period apart from the start and end
+// of the check, so one fewer sweep is complete.
+static const int SWEEP_CHECK_WRAPS = 5;
+static const guint32 SWEEP_CHECK_SEED = 1;
+
+// One run of the sweep, and what it has seen so far.
+struct sweep_check_t {
+  const char *name;
+  struct data_t *data;
+  GRand *rand;
+  // How many pixels a step may be off and still count as even.
+  int step_slack;
+  // Frames drawn after the first one, how many of them moved the bar by the
+  // expected number of pixels, and whether x ever left [0, width).
+  int frames;
+  int even_steps;
+  gboolean out_of_range;
+};
+
+// Ticks the sweep every interval_us from start_us until before end_us, with
+// jittered frame times, on a window of the given width where the bar should
+// move expected_step pixels a frame. Returns the time of the next tick.
+static gint64 run_sweep(struct sweep_check_t *check, gint64 start_us,
+    gint64 end_us, gint64 interval_us, int width, int expected_step) {
+  struct data_t *data = check->data;
+  gint64 t;
+  for (t = start_us; t < end_us; t += interval_us) {
+    gint64 frame_time = t + g_rand_int_range(check->rand,
+        -SWEEP_CHECK_JITTER_US, SWEEP_CHECK_JITTER_US + 1);
+    guint old_x = data->x;
+    if (!sweep_update(data, frame_time, interval_us, width)) {
+      continue;
+    }
+    if (data->x >= (guint)width) {
+      check->out_of_range = TRUE;
+    }
+    if (frame_time == data->start_time) {
+      continue;
+    }
+    int step = ((int)data->x - (int)old_x + width) % width;
+    ++check->frames;
+    if (abs(step - expected_step) <= check->step_slack) {
+      ++check->even_steps;
+    }
+  }
+  return t;
+}
+
+// Returns how many pixels the bar should move per frame on a window of the
+// given width drawn every interval_us.
+static int get_expected_step(int width, gint64 interval_us) {
+  return (int)(width * interval_us / (PERIOD_MS * 1000.0) + 0.5);
+}
+
+// Checks that the bar stayed in the window, moved by the expected number of
+// pixels nearly every frame and swept the window once per period, on average,
+// then frees the run.
+static gboolean finish_sweep_check(struct sweep_check_t *check) {
+  const struct frame_stats_t *stats = &check->data->stats;
+  double mean_sweep_us = stats->sweeps ?
+      (double)stats->total_sweep_us / stats->sweeps : 0;
+  gboolean ok = TRUE;
+  if (check->out_of_range) {
+    g_print("sweep: FAILED: %s: x left the window\n", check->name);
+    ok = FALSE;
+  }
+  if (check->even_steps < check->frames * 0.99) {
+    g_print("sweep: FAILED: %s: %d of %d frames moved the expected number of "
+        "pixels\n", check->name, check->even_steps, check->frames);
+    ok = FALSE;
+  }
+  if (stats->sweeps != SWEEP_CHECK_WRAPS - 1) {
+    g_print("sweep: FAILED: %s: %" G_GUINT64_FORMAT " sweeps, not %d\n",
+        check->name, stats->sweeps, SWEEP_CHECK_WRAPS - 1);
+    ok = FALSE;
+  }
+  if (fabs(mean_sweep_us / (PERIOD_MS * 1000.0) - 1) > 0.001) {
+    g_print("sweep: FAILED: %s: mean sweep took %.1f ms, not %u ms\n",
+        check->name, mean_sweep_us / 1000, PERIOD_MS);
+    ok = FALSE;
+  }
+  if (ok) {
+    g_print("sweep: ok (%s: %d of %d frames moved evenly, mean sweep %.1f "
+        "ms)\n", check->name, check->even_steps, check->frames,
+        mean_sweep_us / 1000);
+  }
+  g_rand_free(check->rand);
+  g_free(check->data);
+  return ok;
+}
+
+// Starts a run of the sweep on a fresh window.
+static void start_sweep_check(struct sweep_check_t *check,
+    const char *name) {
+  memset(check, 0, sizeof(*check));
+  check->name = name;
+  check->data = g_new0(struct data_t, 1);
+  check->rand = g_rand_new_with_seed(SWEEP_CHECK_SEED);
+}
+
+// Sweeps the bar at 60 Hz.
+static gboolean check_sweep(void) {
+  struct sweep_check_t check;
+  start_sweep_check(&check, "60 Hz");
+  const gint64 duration_us = (SWEEP_CHECK_WRAPS + 0.5) * PERIOD_MS * 1000;
+  run_sweep(&check, SWEEP_CHECK_INTERVAL_US, duration_us,
+      SWEEP_CHECK_INTERVAL_US, SWEEP_CHECK_WIDTH,
+      get_expected_step(SWEEP_CHECK_WIDTH, SWEEP_CHECK_INTERVAL_US));
+  return finish_sweep_check(&check);
+}
+
+// Sweeps the bar at 144 Hz with --max-fps, and checks that it is drawn on
+// every third refresh only.
+static gboolean check_sweep_max_fps(void) {
+  struct sweep_check_t check;
+  start_sweep_check(&check, "144 Hz capped");
+  check.data->max_fps = SWEEP_CHECK_MAX_FPS;
+  check.step_slack = 1;
+  const gint64 duration_us = (SWEEP_CHECK_WRAPS + 0.5) * PERIOD_MS * 1000;
+  const gint64 frame_interval_us = 3 * SWEEP_CHECK_FAST_INTERVAL_US;
+  run_sweep(&check, SWEEP_CHECK_FAST_INTERVAL_US, duration_us,
+      SWEEP_CHECK_FAST_INTERVAL_US, SWEEP_CHECK_WIDTH,
+      get_expected_step(SWEEP_CHECK_WIDTH, frame_interval_us));
+  int expected_frames = (int)(duration_us / frame_interval_us) - 1;
+  gboolean ok = TRUE;
+  if (abs(check.frames - expected_frames) > 1) {
+    g_print("sweep: FAILED: %s: %d frames drawn, not %d\n", check.name,
+        check.frames, expected_frames);
+    ok = FALSE;
+  }
+  return finish_sweep_check(&check) && ok;
+}
+
+// Sweeps the bar on a 60 Hz display with ticks from a 144 Hz one, and checks
+// that it is still drawn once per 60 Hz refresh on average.
+static gboolean check_sweep_fast_ticks(void) {
+  struct sweep_check_t check;
+  start_sweep_check(&check, "60 Hz ticked at 144 Hz");
+  check.data->refresh_interval = SWEEP_CHECK_INTERVAL_US;
+  const gint64 duration_us = (SWEEP_CHECK_WRAPS + 0.5) * PERIOD_MS * 1000;
+  run_sweep(&check, SWEEP_CHECK_FAST_INTERVAL_US, duration_us,
+      SWEEP_CHECK_FAST_INTERVAL_US, SWEEP_CHECK_WIDTH,
+      get_expected_step(SWEEP_CHECK_WIDTH, SWEEP_CHECK_INTERVAL_US));
+  int expected_frames = (int)(duration_us / SWEEP_CHECK_INTERVAL_US) - 1;
+  gboolean ok = TRUE;
+  if (abs(check.frames - expected_frames) > 1) {
+    g_print("sweep: FAILED: %s: %d frames drawn, not %d\n", check.name,
+        check.frames, expected_frames);
+    ok = FALSE;
+  }
+  return finish_sweep_check(&check) && ok;
+}
+
+// Sweeps the bar at 60 Hz, and halves the window's width halfway through
+// with a tick between two frames. The bar should keep its place relative to
+// the window straight away, though no frame is due.
+static gboolean check_sweep_resize(void) {
+  struct sweep_check_t check;
+  start_sweep_check(&check, "resized");
+  struct data_t *data = check.data;
+  const gint64 half_us = (SWEEP_CHECK_WRAPS + 0.5) * PERIOD_MS * 500;
+  gint64 next_us = run_sweep(&check, SWEEP_CHECK_INTERVAL_US, half_us,
+      SWEEP_CHECK_INTERVAL_US, SWEEP_CHECK_WIDTH,
+      get_expected_step(SWEEP_CHECK_WIDTH, SWEEP_CHECK_INTERVAL_US));
+
+  double fraction = data->position / SWEEP_CHECK_WIDTH;
+  gint64 resize_time = data->last_update_time + SWEEP_CHECK_INTERVAL_US / 4;
+  gboolean ok = TRUE;
+  if (sweep_update(data, resize_time, SWEEP_CHECK_INTERVAL_US,
+      SWEEP_CHECK_RESIZED_WIDTH)) {
+    g_print("sweep: FAILED: %s: frame due a quarter refresh after the last "
+        "one\n", check.name);
+    ok = FALSE;
+  }
+  guint expected_x = (guint)(fraction * SWEEP_CHECK_RESIZED_WIDTH);
+  if (data->x >= (guint)SWEEP_CHECK_RESIZED_WIDTH ||
+      abs((int)data->x - (int)expected_x) > 1) {
+    g_print("sweep: FAILED: %s: x is %u after resizing, not %u\n",
+        check.name, data->x, expected_x);
+    ok = FALSE;
+  }
+
+  run_sweep(&check, next_us, 2 * half_us, SWEEP_CHECK_INTERVAL_US,
+      SWEEP_CHECK_RESIZED_WIDTH,
+      get_expected_step(SWEEP_CHECK_RESIZED_WIDTH, SWEEP_CHECK_INTERVAL_US));
+  return finish_sweep_check(&check) && ok;
+}
+
+int run_self_test(void) {
+  gboolean ok = check_spanfill();
+  ok = check_render_pool() && ok;
+  ok = check_sweep() && ok;
+  ok = check_sweep_max_fps() && ok;
+  ok = check_sweep_fast_ticks() && ok;
+  ok = check_sweep_resize() && ok;
+  g_print(ok ? "All checks passed\n" : "Some checks failed\n");
+  return ok ? 0 : 1;
+}
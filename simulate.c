@@ -0,0 +1,281 @@
+// Headless simulation of a long cleaning session in virtual time.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <assert.h>
+#include <string.h>
+
+#include "plasmacleaner.h"
+#include "vclock.h"
+
+// The simulated screen, which is rotated to portrait on each resize.
+static const int SIMULATION_WIDTH = 3840;
+static const int SIMULATION_HEIGHT = 2160;
+// A slow frame stalls the main loop for up to this many refreshes.
+static const int MAX_STALL_REFRESHES = 8;
+// Fixed so that runs are repeatable.
+static const guint32 SIMULATION_SEED = 1;
+// Number of rows of the screen, evenly spaced, that exposure is tracked
+// for, and number of bands of columns it is reported for.
+#define EXPOSURE_ROWS 16
+static const int EXPOSURE_BANDS = 16;
+
+// Columns [start, end) of one of the tracked rows, scaled to
+// SIMULATION_WIDTH, that a frame covers with something other than the
+// pattern's first colour.
+struct exposed_span_t {
+  int row;
+  int start;
+  int end;
+};
+
+struct simulation_state_t {
+  const struct simulation_t *params;
+  struct data_t data;
+  GRand *rand;
+  // Current screen size.
+  int width;
+  int height;
+  // Refreshes left that the main loop is stalled for.
+  int stall;
+  guint64 slow_frames;
+  guint64 stalled_refreshes;
+  guint64 resizes;
+  // Frames in which the bar moved.
+  guint64 updates;
+  // What the frame on the screen covers, and since when.
+  GArray *shown;
+  gint64 shown_time;
+  // Microseconds each column of each tracked row has been covered, as
+  // differences between neighbouring columns, so that a frame only adds its
+  // spans' ends. Columns of other widths are scaled to SIMULATION_WIDTH.
+  gint64 *exposure_delta[EXPOSURE_ROWS];
+};
+
+// Adds the exposure of the frame on the screen up to now.
+static void record_exposure(struct simulation_state_t *sim, gint64 now) {
+  gint64 duration = now - sim->shown_time;
+  sim->shown_time = now;
+  for (guint i = 0; i < sim->shown->len; ++i) {
+    const struct exposed_span_t *span =
+        &g_array_index(sim->shown, struct exposed_span_t, i);
+    assert(span->start >= 0 && span->start <= span->end &&
+        span->end <= SIMULATION_WIDTH);
+    sim->exposure_delta[span->row][span->start] += duration;
+    sim->exposure_delta[span->row][span->end] -= duration;
+  }
+}
+
+// Returns column x of a frame of the given width scaled to SIMULATION_WIDTH,
+// clamped to the screen.
+static int scale_column(int x, int width) {
+  return CLAMP((int)((gint64)x * SIMULATION_WIDTH / width), 0,
+      SIMULATION_WIDTH);
+}
+
+// Remembers what of the tracked rows a frame of the given size covers.
+static void show_frame(struct simulation_state_t *sim,
+    const struct pattern_frame_t *frame, int width, int height) {
+  g_array_set_size(sim->shown, 0);
+  int band = 0;
+  for (int row = 0; row < EXPOSURE_ROWS; ++row) {
+    int y = (2 * row + 1) * height / (2 * EXPOSURE_ROWS);
+    while (band < frame->n_bands &&
+        frame->bands[band].y + frame->bands[band].height <= y) {
+      ++band;
+    }
+    if (band == frame->n_bands) {
+      break;
+    }
+    const struct band_t *b = &frame->bands[band];
+    for (int i = 0; i < b->n_spans; ++i) {
+      const struct span_t *s = &b->spans[i];
+      // Patterns keep their spans inside the frame.
+      assert(s->x >= 0 && s->len >= 0 && s->x + s->len <= width);
+      if (s->colour) {
+        struct exposed_span_t span = { row, scale_column(s->x, width),
+            scale_column(s->x + s->len, width) };
+        g_array_append_val(sim->shown, span);
+      }
+    }
+  }
+}
+
+// Stands in for a backend: instead of drawing the frame, it accounts for how
+// long the previous one was shown.
+static gboolean simulated_init(struct data_t *data) {
+  return TRUE;
+}
+
+static void simulated_update(struct data_t *data, int old_x, gboolean full) {
+  struct simulation_state_t *sim =
+      (struct simulation_state_t *)data->backend_data;
+  ++sim->updates;
+  record_exposure(sim, vclock_get_time());
+  show_frame(sim, &data->program.frame, data->width, data->height);
+}
+
+static void simulated_destroy(struct data_t *data) {
+  // The state belongs to run_simulation().
+  data->backend_data = NULL;
+}
+
+// Deferred, since there is no drawing to time.
+static const struct backend_t SIMULATED_BACKEND = {
+  "simulated",
+  "record what would be on the screen",
+  &simulated_init,
+  &simulated_update,
+  &simulated_destroy,
+  TRUE,
+};
+
+// Ticks the window as the frame clock would, unless the main loop is
+// stalled.
+static gboolean on_frame_timer(gpointer user_data) {
+  struct simulation_state_t *sim = (struct simulation_state_t *)user_data;
+  if (sim->stall) {
+    --sim->stall;
+    ++sim->stalled_refreshes;
+    return G_SOURCE_CONTINUE;
+  }
+
+  update_window(&sim->data, vclock_get_time(), DEFAULT_REFRESH_INTERVAL,
+      sim->width, sim->height);
+
+  if (g_rand_double(sim->rand) * 100 < sim->params->slow_frame_percent) {
+    ++sim->slow_frames;
+    sim->stall = g_rand_int_range(sim->rand, 1, MAX_STALL_REFRESHES + 1);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_resize_timer(gpointer user_data) {
+  struct simulation_state_t *sim = (struct simulation_state_t *)user_data;
+  int width = sim->width;
+  sim->width = sim->height;
+  sim->height = width;
+  ++sim->resizes;
+  return G_SOURCE_CONTINUE;
+}
+
+static void print_exposure(const struct simulation_state_t *sim,
+    gint64 duration) {
+  double *exposure[EXPOSURE_ROWS];
+  double min = 1.0;
+  double max = 0.0;
+  double sum = 0.0;
+  for (int row = 0; row < EXPOSURE_ROWS; ++row) {
+    exposure[row] = g_new(double, SIMULATION_WIDTH);
+    gint64 total = 0;
+    for (int i = 0; i < SIMULATION_WIDTH; ++i) {
+      total += sim->exposure_delta[row][i];
+      exposure[row][i] = (double)total / duration;
+      min = MIN(min, exposure[row][i]);
+      max = MAX(max, exposure[row][i]);
+      sum += exposure[row][i];
+    }
+  }
+  double mean = sum / SIMULATION_WIDTH / EXPOSURE_ROWS;
+  g_print("  exposure (%s): min=%.4f%% mean=%.4f%% max=%.4f%% "
+      "spread=%.4f%%\n", sim->data.pattern->name, min * 100, mean * 100,
+      max * 100, (max - min) / mean * 100);
+
+  for (int band = 0; band < EXPOSURE_BANDS; ++band) {
+    int start = band * SIMULATION_WIDTH / EXPOSURE_BANDS;
+    int end = (band + 1) * SIMULATION_WIDTH / EXPOSURE_BANDS;
+    double band_min = 1.0;
+    double band_max = 0.0;
+    for (int row = 0; row < EXPOSURE_ROWS; ++row) {
+      for (int i = start; i < end; ++i) {
+        band_min = MIN(band_min, exposure[row][i]);
+        band_max = MAX(band_max, exposure[row][i]);
+      }
+    }
+    g_print("    columns %4d-%-4d min=%.4f%% max=%.4f%%\n", start, end - 1,
+        band_min * 100, band_max * 100);
+  }
+  for (int row = 0; row < EXPOSURE_ROWS; ++row) {
+    g_free(exposure[row]);
+  }
+}
+
+int run_simulation(const struct simulation_t *params) {
+  if (params->hours <= 0 || params->slow_frame_percent < 0 ||
+      params->slow_frame_percent > 100 || params->resize_minutes < 0) {
+    g_printerr("Invalid simulation parameters\n");
+    return 1;
+  }
+
+  struct simulation_state_t sim;
+  memset(&sim, 0, sizeof(sim));
+  sim.params = params;
+  sim.data.backend = &SIMULATED_BACKEND;
+  sim.data.backend_data = &sim;
+  sim.data.pattern = params->pattern;
+  sim.data.max_fps = params->max_fps;
+  sim.data.refresh_interval = DEFAULT_REFRESH_INTERVAL;
+  sim.data.backend->init(&sim.data);
+  sim.rand = g_rand_new_with_seed(SIMULATION_SEED);
+  sim.width = SIMULATION_WIDTH;
+  sim.height = SIMULATION_HEIGHT;
+  sim.shown = g_array_new(FALSE, FALSE, sizeof(struct exposed_span_t));
+  for (int row = 0; row < EXPOSURE_ROWS; ++row) {
+    sim.exposure_delta[row] = g_new0(gint64, SIMULATION_WIDTH + 1);
+  }
+
+  // Start well away from 0, which data_t uses to mean "no time yet".
+  const gint64 start = G_USEC_PER_SEC;
+  const gint64 duration = (gint64)(params->hours * 3600 * G_USEC_PER_SEC);
+  vclock_use_virtual(start);
+  sim.shown_time = start;
+  guint frame_id = vclock_add_timeout(DEFAULT_REFRESH_INTERVAL,
+      &on_frame_timer, &sim);
+  guint resize_id = 0;
+  if (params->resize_minutes) {
+    resize_id = vclock_add_timeout((gint64)params->resize_minutes * 60 *
+        G_USEC_PER_SEC, &on_resize_timer, &sim);
+  }
+
+  gint64 start_ns = get_monotonic_ns();
+  vclock_advance_to(start + duration);
+  record_exposure(&sim, start + duration);
+  double elapsed = (get_monotonic_ns() - start_ns) / 1e9;
+
+  vclock_remove_timeout(frame_id);
+  if (resize_id) {
+    vclock_remove_timeout(resize_id);
+  }
+
+  g_print("Simulated %.2f h at %dx%d in %.2f s\n", params->hours,
+      SIMULATION_WIDTH, SIMULATION_HEIGHT, elapsed);
+  g_print("  updates=%" G_GUINT64_FORMAT " slow frames=%" G_GUINT64_FORMAT
+      " (%" G_GUINT64_FORMAT " refreshes stalled) resizes=%" G_GUINT64_FORMAT
+      "\n", sim.updates, sim.slow_frames, sim.stalled_refreshes, sim.resizes);
+  print_exposure(&sim, duration);
+  stats_dump(&sim.data.stats, "virtual");
+
+  sim.data.backend->destroy(&sim.data);
+  span_program_free(&sim.data.program);
+  for (int row = 0; row < EXPOSURE_ROWS; ++row) {
+    g_free(sim.exposure_delta[row]);
+  }
+  g_array_free(sim.shown, TRUE);
+  g_rand_free(sim.rand);
+  return 0;
+}
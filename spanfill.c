@@ -0,0 +1,284 @@
+// Software raster core that fills runs of solid colour in pixel buffers. The
+// fill kernel is chosen at runtime from what the CPU supports.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <string.h>
+
+#include "spanfill.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SPANFILL_X86 1
+#include <immintrin.h>
+#endif
+
+// Fills smaller than this use ordinary stores even in the non-temporal
+// kernels, since bypassing the cache only pays off for large areas.
+static const size_t NON_TEMPORAL_THRESHOLD = 1024;
+
+static void fill_scalar(void *dst, guint32 pattern, size_t bytes) {
+  guint32 *p = (guint32 *)dst;
+  for (size_t i = 0; i < bytes / 4; ++i) {
+    p[i] = pattern;
+  }
+}
+
+#ifdef SPANFILL_X86
+
+// Fills with scalar stores until p is aligned to alignment, and returns the
+// number of bytes written.
+static size_t fill_head(guint32 *p, guint32 pattern, size_t bytes,
+    size_t alignment) {
+  size_t head = (alignment - ((uintptr_t)p & (alignment - 1))) &
+      (alignment - 1);
+  head = MIN(head, bytes);
+  fill_scalar(p, pattern, head);
+  return head;
+}
+
+__attribute__((target("sse2")))
+static void fill_sse2(void *dst, guint32 pattern, size_t bytes) {
+  if (bytes < NON_TEMPORAL_THRESHOLD) {
+    fill_scalar(dst, pattern, bytes);
+    return;
+  }
+  size_t head = fill_head((guint32 *)dst, pattern, bytes, 16);
+  char *p = (char *)dst + head;
+  bytes -= head;
+  __m128i v = _mm_set1_epi32((int)pattern);
+  for (; bytes >= 64; p += 64, bytes -= 64) {
+    _mm_stream_si128((__m128i *)p, v);
+    _mm_stream_si128((__m128i *)(p + 16), v);
+    _mm_stream_si128((__m128i *)(p + 32), v);
+    _mm_stream_si128((__m128i *)(p + 48), v);
+  }
+  for (; bytes >= 16; p += 16, bytes -= 16) {
+    _mm_stream_si128((__m128i *)p, v);
+  }
+  fill_scalar(p, pattern, bytes);
+}
+
+__attribute__((target("avx2")))
+static void fill_avx2(void *dst, guint32 pattern, size_t bytes) {
+  if (bytes < NON_TEMPORAL_THRESHOLD) {
+    fill_scalar(dst, pattern, bytes);
+    return;
+  }
+  size_t head = fill_head((guint32 *)dst, pattern, bytes, 32);
+  char *p = (char *)dst + head;
+  bytes -= head;
+  __m256i v = _mm256_set1_epi32((int)pattern);
+  for (; bytes >= 128; p += 128, bytes -= 128) {
+    _mm256_stream_si256((__m256i *)p, v);
+    _mm256_stream_si256((__m256i *)(p + 32), v);
+    _mm256_stream_si256((__m256i *)(p + 64), v);
+    _mm256_stream_si256((__m256i *)(p + 96), v);
+  }
+  for (; bytes >= 32; p += 32, bytes -= 32) {
+    _mm256_stream_si256((__m256i *)p, v);
+  }
+  fill_scalar(p, pattern, bytes);
+}
+
+__attribute__((target("avx512f")))
+static void fill_avx512(void *dst, guint32 pattern, size_t bytes) {
+  if (bytes < NON_TEMPORAL_THRESHOLD) {
+    fill_scalar(dst, pattern, bytes);
+    return;
+  }
+  size_t head = fill_head((guint32 *)dst, pattern, bytes, 64);
+  char *p = (char *)dst + head;
+  bytes -= head;
+  __m512i v = _mm512_set1_epi32((int)pattern);
+  for (; bytes >= 64; p += 64, bytes -= 64) {
+    _mm512_stream_si512((void *)p, v);
+  }
+  fill_scalar(p, pattern, bytes);
+}
+
+__attribute__((target("sse2")))
+static void store_fence(void) {
+  _mm_sfence();
+}
+
+#endif  // SPANFILL_X86
+
+static const struct spanfill_kernel_t SCALAR_KERNEL = {
+  "scalar", &fill_scalar, FALSE
+};
+#ifdef SPANFILL_X86
+static const struct spanfill_kernel_t SSE2_KERNEL = {
+  "sse2", &fill_sse2, TRUE
+};
+static const struct spanfill_kernel_t AVX2_KERNEL = {
+  "avx2", &fill_avx2, TRUE
+};
+static const struct spanfill_kernel_t AVX512_KERNEL = {
+  "avx512", &fill_avx512, TRUE
+};
+#endif
+
+static const struct spanfill_kernel_t *kernels[4];
+static int n_kernels;
+static const struct spanfill_kernel_t *current_kernel;
+
+// Detects the kernels on first use. Render pool workers may all get here at
+// once on the first frame, so only one of them does the work.
+static void detect_kernels(void) {
+  static gsize detected = 0;
+  if (!g_once_init_enter(&detected)) {
+    return;
+  }
+  kernels[n_kernels++] = &SCALAR_KERNEL;
+#ifdef SPANFILL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) {
+    kernels[n_kernels++] = &SSE2_KERNEL;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    kernels[n_kernels++] = &AVX2_KERNEL;
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    kernels[n_kernels++] = &AVX512_KERNEL;
+  }
+#endif
+  current_kernel = kernels[n_kernels - 1];
+  g_once_init_leave(&detected, 1);
+}
+
+const struct spanfill_kernel_t *const *spanfill_get_kernels(int *n) {
+  detect_kernels();
+  *n = n_kernels;
+  return kernels;
+}
+
+const struct spanfill_kernel_t *spanfill_get_best_kernel(void) {
+  detect_kernels();
+  return kernels[n_kernels - 1];
+}
+
+void spanfill_set_kernel(const struct spanfill_kernel_t *kernel) {
+  detect_kernels();
+  current_kernel = kernel;
+}
+
+int pixel_format_get_bytes(enum pixel_format_t format) {
+  return format == PIXEL_FORMAT_R5G6B5 ? 2 : 4;
+}
+
+const char *pixel_format_get_name(enum pixel_format_t format) {
+  switch (format) {
+    case PIXEL_FORMAT_X8R8G8B8:
+      return "x8r8g8b8";
+    case PIXEL_FORMAT_R5G6B5:
+      return "r5g6b5";
+    case PIXEL_FORMAT_A2R10G10B10:
+      return "a2r10g10b10";
+  }
+  return "unknown";
+}
+
+static guint32 scale(double value, int bits) {
+  return (guint32)(CLAMP(value, 0.0, 1.0) * ((1u << bits) - 1) + 0.5);
+}
+
+guint32 pixel_format_pack(enum pixel_format_t format, double r, double g,
+    double b) {
+  switch (format) {
+    case PIXEL_FORMAT_X8R8G8B8:
+      return scale(r, 8) << 16 | scale(g, 8) << 8 | scale(b, 8);
+    case PIXEL_FORMAT_R5G6B5:
+      return scale(r, 5) << 11 | scale(g, 6) << 5 | scale(b, 5);
+    case PIXEL_FORMAT_A2R10G10B10:
+      return 3u << 30 | scale(r, 10) << 20 | scale(g, 10) << 10 |
+          scale(b, 10);
+  }
+  return 0;
+}
+
+// Fills len pixels starting at p, which is at least 2-byte aligned for
+// r5g6b5 and 4-byte aligned otherwise.
+static void fill_pixels(char *p, enum pixel_format_t format, int len,
+    guint32 pixel) {
+  if (len <= 0) {
+    return;
+  }
+  if (format != PIXEL_FORMAT_R5G6B5) {
+    current_kernel->fill(p, pixel, (size_t)len * 4);
+    return;
+  }
+  // Kernels store 32 bits at a time, so fill two 16-bit pixels per store and
+  // handle an unaligned first pixel and an odd last pixel separately.
+  guint16 pixel16 = (guint16)pixel;
+  if ((uintptr_t)p & 2) {
+    *(guint16 *)p = pixel16;
+    p += 2;
+    --len;
+  }
+  current_kernel->fill(p, (guint32)pixel16 << 16 | pixel16,
+      (size_t)(len / 2) * 4);
+  if (len & 1) {
+    *(guint16 *)(p + (size_t)(len - 1) * 2) = pixel16;
+  }
+}
+
+// spanfill_rows() without the fence.
+static void fill_rows(void *pixels, int stride, enum pixel_format_t format,
+    int y, int height, const struct span_t *spans, int n,
+    const guint32 *palette) {
+  int bytes_per_pixel = pixel_format_get_bytes(format);
+  for (int row = y; row < y + height; ++row) {
+    char *p = (char *)pixels + (size_t)row * stride;
+    for (int i = 0; i < n; ++i) {
+      fill_pixels(p + (size_t)spans[i].x * bytes_per_pixel, format,
+          spans[i].len, palette[spans[i].colour]);
+    }
+  }
+}
+
+static void fence_if_needed(void) {
+#ifdef SPANFILL_X86
+  if (current_kernel->non_temporal) {
+    store_fence();
+  }
+#endif
+}
+
+void spanfill_rows(void *pixels, int stride, enum pixel_format_t format,
+    int y, int height, const struct span_t *spans, int n,
+    const guint32 *palette) {
+  detect_kernels();
+  fill_rows(pixels, stride, format, y, height, spans, n, palette);
+  fence_if_needed();
+}
+
+void spanfill_frame(void *pixels, int stride, enum pixel_format_t format,
+    int y, int height, const struct pattern_frame_t *frame,
+    const guint32 *palette) {
+  detect_kernels();
+  for (int i = 0; i < frame->n_bands; ++i) {
+    const struct band_t *band = &frame->bands[i];
+    int y0 = MAX(band->y, y);
+    int y1 = MIN(band->y + band->height, y + height);
+    if (y0 < y1) {
+      fill_rows(pixels, stride, format, y0, y1 - y0, band->spans,
+          band->n_spans, palette);
+    }
+  }
+  fence_if_needed();
+}
@@ -0,0 +1,66 @@
+// Software raster core that fills runs of solid colour in pixel buffers.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#ifndef SPANFILL_H_
+#define SPANFILL_H_
+
+#include <glib.h>
+
+#include "plasmacleaner.h"
+
+enum pixel_format_t {
+  PIXEL_FORMAT_X8R8G8B8,
+  PIXEL_FORMAT_R5G6B5,
+  PIXEL_FORMAT_A2R10G10B10,
+};
+
+// A function that fills bytes bytes at dst with a repeating 32-bit pattern.
+// dst must be 4-byte aligned and bytes a multiple of 4.
+struct spanfill_kernel_t {
+  const char *name;
+  void (*fill)(void *dst, guint32 pattern, size_t bytes);
+  // Whether the kernel uses non-temporal stores, which must be fenced before
+  // another thread or the X server reads the buffer.
+  gboolean non_temporal;
+};
+
+// Returns the kernels this CPU supports, slowest first.
+const struct spanfill_kernel_t *const *spanfill_get_kernels(int *n);
+// Returns the fastest kernel this CPU supports.
+const struct spanfill_kernel_t *spanfill_get_best_kernel(void);
+// Uses the given kernel from now on instead of the best one.
+void spanfill_set_kernel(const struct spanfill_kernel_t *kernel);
+
+int pixel_format_get_bytes(enum pixel_format_t format);
+const char *pixel_format_get_name(enum pixel_format_t format);
+guint32 pixel_format_pack(enum pixel_format_t format, double r, double g,
+    double b);
+
+// Fills rows [y, y + height) of a buffer with the given spans, where each
+// span's colour is palette[span.colour]. Ends with a store fence if needed.
+void spanfill_rows(void *pixels, int stride, enum pixel_format_t format,
+    int y, int height, const struct span_t *spans, int n,
+    const guint32 *palette);
+// Likewise, but with the part of frame that lies within rows
+// [y, y + height).
+void spanfill_frame(void *pixels, int stride, enum pixel_format_t format,
+    int y, int height, const struct pattern_frame_t *frame,
+    const guint32 *palette);
+
+#endif  // SPANFILL_H_
@@ -0,0 +1,184 @@
+// Frame timing statistics. Nothing here allocates, so it is safe to call
+// from the per-frame path.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <time.h>
+
+#include "plasmacleaner.h"
+#include "stats.h"
+
+#define SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+
+gint64 get_monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int get_bucket(gint64 value) {
+  if (value < SUB_BUCKETS) {
+    return value < 0 ? 0 : (int)value;
+  }
+  if (value >= (G_GINT64_CONSTANT(1) << HISTOGRAM_MAX_BITS)) {
+    return HISTOGRAM_BUCKETS - 1;
+  }
+  int msb = 63 - __builtin_clzll((guint64)value);
+  int shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+  return ((shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) +
+      (int)((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+// Returns the largest value that falls in the given bucket.
+static gint64 get_bucket_limit(int bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return bucket;
+  }
+  int shift = (bucket >> HISTOGRAM_SUB_BUCKET_BITS) - 1;
+  gint64 sub_bucket = bucket & (SUB_BUCKETS - 1);
+  return ((SUB_BUCKETS + sub_bucket + 1) << shift) - 1;
+}
+
+void histogram_record(struct histogram_t *histogram, gint64 value) {
+  ++histogram->counts[get_bucket(value)];
+  if (!histogram->count || value < histogram->min) {
+    histogram->min = value;
+  }
+  if (!histogram->count || value > histogram->max) {
+    histogram->max = value;
+  }
+  ++histogram->count;
+  histogram->sum += value;
+}
+
+gint64 histogram_percentile(const struct histogram_t *histogram,
+    double percentile) {
+  if (!histogram->count) {
+    return 0;
+  }
+  guint64 rank = (guint64)(percentile / 100 * histogram->count);
+  guint64 seen = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    seen += histogram->counts[i];
+    if (seen > rank) {
+      return MIN(get_bucket_limit(i), histogram->max);
+    }
+  }
+  return histogram->max;
+}
+
+void stats_record_frame(struct frame_stats_t *stats, gint64 frame_time,
+    gint64 refresh_interval) {
+  if (stats->last_frame_time) {
+    gint64 interval = frame_time - stats->last_frame_time;
+    histogram_record(&stats->frame_interval, interval * 1000);
+    if (refresh_interval > 0 && interval > refresh_interval * 3 / 2) {
+      ++stats->late_frames;
+      stats->missed_frames +=
+          (interval + refresh_interval / 2) / refresh_interval - 1;
+    }
+  }
+  stats->last_frame_time = frame_time;
+  ++stats->frames;
+}
+
+void stats_record_draw(struct frame_stats_t *stats, gint64 duration_ns) {
+  histogram_record(&stats->draw_duration, duration_ns);
+}
+
+void stats_record_present(struct frame_stats_t *stats, gint64 latency_ns,
+    gboolean late, gboolean skipped) {
+  if (skipped) {
+    ++stats->skipped_presents;
+    return;
+  }
+  ++stats->presented_frames;
+  histogram_record(&stats->present_latency, latency_ns);
+  if (late) {
+    ++stats->late_presents;
+  }
+}
+
+void stats_record_sweep(struct frame_stats_t *stats, gint64 frame_time) {
+  if (stats->last_sweep_time) {
+    gint64 sweep_us = frame_time - stats->last_sweep_time;
+    if (!stats->sweeps || sweep_us < stats->min_sweep_us) {
+      stats->min_sweep_us = sweep_us;
+    }
+    if (!stats->sweeps || sweep_us > stats->max_sweep_us) {
+      stats->max_sweep_us = sweep_us;
+    }
+    stats->total_sweep_us += sweep_us;
+    ++stats->sweeps;
+  }
+  stats->last_sweep_time = frame_time;
+}
+
+void stats_pause(struct frame_stats_t *stats) {
+  stats->last_frame_time = 0;
+  stats->last_sweep_time = 0;
+}
+
+static void dump_histogram(const struct histogram_t *histogram,
+    const char *name) {
+  if (!histogram->count) {
+    g_print("  %s: no samples\n", name);
+    return;
+  }
+  g_print("  %s (us): n=%" G_GUINT64_FORMAT " mean=%.1f min=%.1f p50=%.1f "
+      "p90=%.1f p99=%.1f p99.9=%.1f max=%.1f\n", name, histogram->count,
+      histogram->sum / histogram->count / 1000, histogram->min / 1000.0,
+      histogram_percentile(histogram, 50) / 1000.0,
+      histogram_percentile(histogram, 90) / 1000.0,
+      histogram_percentile(histogram, 99) / 1000.0,
+      histogram_percentile(histogram, 99.9) / 1000.0,
+      histogram->max / 1000.0);
+}
+
+void stats_dump(const struct frame_stats_t *stats, const char *name) {
+  g_print("%s: %" G_GUINT64_FORMAT " frames, %" G_GUINT64_FORMAT
+      " late, %" G_GUINT64_FORMAT " refresh cycles missed, %" G_GUINT64_FORMAT
+      " dropped\n", name, stats->frames, stats->late_frames,
+      stats->missed_frames, stats->dropped_frames);
+  if (stats->x11_requests && stats->frames) {
+    g_print("  X11 requests per frame: %.2f", (double)stats->x11_requests /
+        stats->frames);
+    if (stats->x11_request_bytes) {
+      g_print(", %.1f bytes", (double)stats->x11_request_bytes /
+          stats->frames);
+    }
+    g_print("\n");
+  }
+  dump_histogram(&stats->frame_interval, "frame interval");
+  dump_histogram(&stats->draw_duration, "draw duration");
+  if (stats->presented_frames || stats->skipped_presents) {
+    g_print("  presented: %" G_GUINT64_FORMAT " frames, %" G_GUINT64_FORMAT
+        " late, %" G_GUINT64_FORMAT " skipped\n", stats->presented_frames,
+        stats->late_presents, stats->skipped_presents);
+    dump_histogram(&stats->present_latency, "submit to on-glass");
+  }
+  if (stats->sweeps) {
+    double mean_ms = stats->total_sweep_us / 1000.0 / stats->sweeps;
+    g_print("  sweep period (ms): n=%" G_GUINT64_FORMAT " mean=%.3f "
+        "min=%.3f max=%.3f target=%u error=%+.3f%%\n", stats->sweeps, mean_ms,
+        stats->min_sweep_us / 1000.0, stats->max_sweep_us / 1000.0,
+        PERIOD_MS, (mean_ms - PERIOD_MS) * 100 / PERIOD_MS);
+  } else {
+    g_print("  sweep period: no complete sweeps\n");
+  }
+}
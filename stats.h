@@ -0,0 +1,104 @@
+// Frame timing statistics.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <glib.h>
+
+// Histogram buckets are log-linear: each power of two is split into
+// 2^HISTOGRAM_SUB_BUCKET_BITS linear sub-buckets, giving about 6% precision
+// over the whole range. Values at or above 2^HISTOGRAM_MAX_BITS are clamped.
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKETS \
+  ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BUCKET_BITS + 1) << \
+      HISTOGRAM_SUB_BUCKET_BITS)
+
+struct histogram_t {
+  guint64 counts[HISTOGRAM_BUCKETS];
+  guint64 count;
+  gint64 min;
+  gint64 max;
+  double sum;
+};
+
+struct frame_stats_t {
+  // Time between consecutive ticks, in nanoseconds.
+  struct histogram_t frame_interval;
+  // Time spent in the draw handler, in nanoseconds.
+  struct histogram_t draw_duration;
+  // Frame time (in microseconds) of the last tick, or 0 before the first.
+  gint64 last_frame_time;
+  guint64 frames;
+  // Ticks that came more than half a refresh interval late, and the number of
+  // refresh cycles that were skipped as a result.
+  guint64 late_frames;
+  guint64 missed_frames;
+  // Frames a backend skipped because it had no free buffer to render into.
+  guint64 dropped_frames;
+  // X11 requests issued while drawing, and the total size in bytes of those
+  // whose size the backend knows.
+  guint64 x11_requests;
+  guint64 x11_request_bytes;
+  // Frames that a backend with presentation feedback saw reach the screen,
+  // how long after submission they did (in nanoseconds), and how many were
+  // shown after the refresh they targeted or skipped altogether.
+  guint64 presented_frames;
+  struct histogram_t present_latency;
+  guint64 late_presents;
+  guint64 skipped_presents;
+  // Frame time (in microseconds) at which the bar last wrapped around, or 0
+  // before the first wrap or since a pause.
+  gint64 last_sweep_time;
+  // Complete sweeps between wraps, and their total, shortest and longest
+  // durations in microseconds.
+  guint64 sweeps;
+  gint64 total_sweep_us;
+  gint64 min_sweep_us;
+  gint64 max_sweep_us;
+};
+
+// Returns CLOCK_MONOTONIC in nanoseconds.
+gint64 get_monotonic_ns(void);
+
+void histogram_record(struct histogram_t *histogram, gint64 value);
+// Returns an upper bound on the value at the given percentile.
+gint64 histogram_percentile(const struct histogram_t *histogram,
+    double percentile);
+
+// Records a tick at frame_time. refresh_interval is the display's refresh
+// interval in microseconds, or 0 if unknown.
+void stats_record_frame(struct frame_stats_t *stats, gint64 frame_time,
+    gint64 refresh_interval);
+void stats_record_draw(struct frame_stats_t *stats, gint64 duration_ns);
+// Records presentation feedback for a frame submitted latency_ns before it
+// reached the screen, or that was skipped. late is whether it was shown after
+// the refresh it targeted.
+void stats_record_present(struct frame_stats_t *stats, gint64 latency_ns,
+    gboolean late, gboolean skipped);
+// Records that the bar wrapped around at frame_time.
+void stats_record_sweep(struct frame_stats_t *stats, gint64 frame_time);
+// Stops the next frame interval and sweep from being measured from before
+// now, e.g. while ticks are being recorded into other stats.
+void stats_pause(struct frame_stats_t *stats);
+// Prints stats to stdout, prefixed by name.
+void stats_dump(const struct frame_stats_t *stats, const char *name);
+
+#endif  // STATS_H_
@@ -0,0 +1,139 @@
+// Advances the bar from one frame to the next.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <math.h>
+
+#include "plasmacleaner.h"
+
+// Returns value wrapped into [0, width).
+static double wrap(double value, int width) {
+  value = fmod(value, width);
+  return value < 0 ? value + width : value;
+}
+
+// Returns when a frame submitted at frame_time will reach the screen, going
+// by the backend's presentation feedback, and sets data->next_present_msc to
+// the refresh it will be shown in. Returns frame_time if there's no feedback.
+static gint64 predict_present_time(struct data_t *data, gint64 frame_time) {
+  if (!data->present_interval) {
+    return frame_time;
+  }
+  // The first refresh after both frame_time and the last one shown.
+  gint64 refreshes = MAX(1, (frame_time - data->present_time +
+      data->present_interval - 1) / data->present_interval);
+  data->next_present_msc = data->present_msc + refreshes;
+  return data->present_time + refreshes * data->present_interval;
+}
+
+gboolean sweep_update(struct data_t *data, gint64 frame_time,
+    gint64 tick_interval, int width) {
+  if (tick_interval <= 0) {
+    tick_interval = DEFAULT_REFRESH_INTERVAL;
+  }
+  gint64 refresh_interval = data->refresh_interval > 0 ?
+      data->refresh_interval : tick_interval;
+  // Render on every n-th refresh if capped, so frames stay aligned with the
+  // display.
+  gint64 interval = refresh_interval;
+  if (data->max_fps > 0) {
+    double refresh_rate = 1e6 / refresh_interval;
+    interval *= MAX(1, (int)ceil(refresh_rate / data->max_fps - 0.01));
+  }
+
+  // Keep the bar at the same fraction of the window when it is resized, even
+  // if no frame is due, since the window is redrawn at the new size anyway.
+  if (width != data->sweep_width) {
+    if (data->sweep_width) {
+      data->position = wrap(data->position * width / data->sweep_width,
+          width);
+      data->x = MIN((guint)data->position, (guint)width - 1);
+    }
+    data->sweep_width = width;
+  }
+
+  if (!data->start_time) {
+    data->start_time = frame_time;
+  } else if (frame_time - data->last_update_time <
+      interval - tick_interval / 2) {
+    // Not due yet.
+    return FALSE;
+  }
+
+  const double period_us = PERIOD_MS * 1000.0;
+  gboolean wrapped = FALSE;
+  gint64 update_time = frame_time;
+  if (data->last_update_time) {
+    // Advance by a whole number of frames, so that the step is the same every
+    // frame even if the frame times jitter.
+    gint64 frames = MAX(1, (frame_time - data->last_update_time +
+        interval / 2) / interval);
+    // The refresh this frame is for. Ticks faster than the window's refreshes
+    // don't line up with them, so this follows the frame times only slowly,
+    // which still gives one step per refresh on average.
+    update_time = data->last_update_time + frames * interval;
+    update_time += (frame_time - update_time) / 16;
+    double step = width * interval / period_us;
+    double position = data->position + frames * step;
+    // Where the bar should be according to the clock. Drift from rounding or
+    // an inexact refresh rate is corrected gradually; anything bigger than a
+    // step (e.g. after a stall) is corrected at once.
+    double ideal = (update_time - data->start_time) / period_us * width;
+    double error = wrap(ideal - position + width / 2.0, width) - width / 2.0;
+    if (fabs(error) > step) {
+      position += error;
+    } else {
+      position += error / 64;
+    }
+    // Only running off the end counts as a sweep, not a correction back
+    // across the start.
+    wrapped = position >= width;
+    data->position = wrap(position, width);
+  }
+  data->last_update_time = update_time;
+
+  if (wrapped) {
+    stats_record_sweep(&data->stats, frame_time);
+  }
+  // wrap() can round a position just below 0 up to exactly width.
+  data->x = MIN((guint)data->position, (guint)width - 1);
+  return TRUE;
+}
+
+void update_window(struct data_t *data, gint64 frame_time,
+    gint64 tick_interval, int width, int height) {
+  stats_record_frame(&data->stats, frame_time, tick_interval);
+
+  int old_x = data->x;
+  gint64 sweep_time = predict_present_time(data, frame_time);
+  gboolean due = sweep_update(data, sweep_time, tick_interval, width);
+  gboolean full = data->damaged || width != data->width ||
+      height != data->height;
+  if ((due && data->x != old_x) || full) {
+    data->width = width;
+    data->height = height;
+    data->damaged = FALSE;
+    span_program_compile(&data->program, data->pattern, width, height);
+    span_program_run(&data->program, data->x);
+    gint64 start_ns = get_monotonic_ns();
+    data->backend->update(data, old_x, full);
+    if (!data->backend->deferred) {
+      stats_record_draw(&data->stats, get_monotonic_ns() - start_ns);
+    }
+  }
+}
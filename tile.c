@@ -0,0 +1,131 @@
+// Backend where the X server does all the painting: the bar is the tiled
+// background of a window twice the screen width, which is moved to animate it.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include "x11.h"
+
+struct tile_t {
+  // Clips the strip to the screen.
+  struct x11_window_t xw;
+  // The pattern's colours.
+  GC gcs[MAX_PATTERN_COLOURS];
+  // A window of twice the width, whose background is tiled with bar_pixmap.
+  // Its origin, and so the tile origin, is kept in [-width, 0). None if the
+  // pattern doesn't scroll, in which case frames are filled in directly.
+  Window strip;
+  Pixmap bar_pixmap;
+  int bar_width;
+  int strip_height;
+};
+
+// Size in bytes of a ConfigureWindow request that moves a window.
+#define X11_MOVE_WINDOW_BYTES 20
+
+// (Re-)creates the tile and resizes the strip if the size has changed.
+static void update_strip(struct tile_t *tile, struct data_t *data) {
+  struct x11_window_t *xw = &tile->xw;
+  if (tile->bar_pixmap && tile->bar_width == xw->width &&
+      tile->strip_height == xw->height) {
+    return;
+  }
+  if (tile->bar_pixmap) {
+    XFreePixmap(xw->display, tile->bar_pixmap);
+  }
+
+  tile->bar_pixmap = XCreatePixmap(xw->display, xw->window, xw->width, 1,
+      xw->depth);
+  const struct band_t band = { 0, 1, data->program.row, data->program.n_row };
+  const struct pattern_frame_t row = { &band, 1 };
+  XRectangle clip = { 0, 0, xw->width, 1 };
+  data->stats.x11_request_bytes += x11_fill_frame(xw, tile->bar_pixmap,
+      tile->gcs, &row, &clip);
+
+  XSetWindowBackgroundPixmap(xw->display, tile->strip, tile->bar_pixmap);
+  XResizeWindow(xw->display, tile->strip, xw->width * 2, xw->height);
+  XClearWindow(xw->display, tile->strip);
+  tile->bar_width = xw->width;
+  tile->strip_height = xw->height;
+}
+
+static void tile_destroy(struct data_t *data) {
+  struct tile_t *tile = (struct tile_t *)data->backend_data;
+  if (!tile) {
+    return;
+  }
+  if (tile->xw.window) {
+    if (tile->strip) {
+      XDestroyWindow(tile->xw.display, tile->strip);
+    }
+    if (tile->bar_pixmap) {
+      XFreePixmap(tile->xw.display, tile->bar_pixmap);
+    }
+    x11_free_pattern_gcs(&tile->xw, data->pattern, tile->gcs);
+    x11_window_destroy(&tile->xw);
+  }
+  g_free(tile);
+  data->backend_data = NULL;
+}
+
+static gboolean tile_init(struct data_t *data) {
+  struct tile_t *tile = g_new0(struct tile_t, 1);
+  data->backend_data = tile;
+  if (!x11_window_init(&tile->xw, data)) {
+    tile_destroy(data);
+    return FALSE;
+  }
+  struct x11_window_t *xw = &tile->xw;
+  x11_create_pattern_gcs(xw, data->pattern, tile->gcs);
+  if (!data->pattern->scrolls) {
+    return TRUE;
+  }
+  // No event mask, so that input propagates to the GTK window.
+  tile->strip = XCreateWindow(xw->display, xw->window, -xw->width, 0,
+      xw->width * 2, xw->height, 0, xw->depth, InputOutput, xw->visual, 0,
+      NULL);
+  XMapWindow(xw->display, tile->strip);
+  return TRUE;
+}
+
+static void tile_update(struct data_t *data, int old_x, gboolean full) {
+  struct tile_t *tile = (struct tile_t *)data->backend_data;
+  struct x11_window_t *xw = &tile->xw;
+  x11_window_update_size(xw);
+  if (!tile->strip) {
+    XRectangle clip = { 0, 0, xw->width, xw->height };
+    data->stats.x11_request_bytes += x11_fill_frame(xw, xw->window,
+        tile->gcs, &data->program.frame, &clip);
+    XFlush(xw->display);
+    return;
+  }
+  update_strip(tile, data);
+  // The tile origin follows the strip's origin, so putting it at x - width
+  // puts a bar at x.
+  XMoveWindow(xw->display, tile->strip, (int)data->x - xw->width, 0);
+  data->stats.x11_request_bytes += X11_MOVE_WINDOW_BYTES;
+  XFlush(xw->display);
+}
+
+const struct backend_t TILE_BACKEND = {
+  "tile",
+  "move a window whose background is tiled with the bar",
+  &tile_init,
+  &tile_update,
+  &tile_destroy,
+  FALSE,
+};
@@ -0,0 +1,163 @@
+// Timing thread.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "timing.h"
+
+struct timing_thread_t {
+  GThread *thread;
+  gint64 interval_us;
+  gboolean has_rt;
+  struct realtime_t rt;
+  int timer_fd;
+  int event_fd;
+  gboolean quit;
+  // CLOCK_MONOTONIC time of tick 0, in microseconds.
+  gint64 start_time;
+
+  // The latest tick, published with a sequence lock: the timing thread is the
+  // only writer, and makes seq odd while it updates tick. Readers retry until
+  // they see the same even seq before and after reading.
+  guint seq;
+  struct timing_tick_t tick;
+};
+
+static gint64 timespec_to_us(const struct timespec *ts) {
+  return (gint64)ts->tv_sec * 1000000 + ts->tv_nsec / 1000;
+}
+
+static struct timespec us_to_timespec(gint64 us) {
+  return (struct timespec){ us / 1000000, us % 1000000 * 1000 };
+}
+
+static void publish(struct timing_thread_t *timing, gint64 time,
+    guint64 count) {
+  guint seq = timing->seq;
+  __atomic_store_n(&timing->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&timing->tick.time, time, __ATOMIC_RELAXED);
+  __atomic_store_n(&timing->tick.count, count, __ATOMIC_RELAXED);
+  __atomic_store_n(&timing->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static gpointer timing_thread(gpointer user_data) {
+  struct timing_thread_t *timing = (struct timing_thread_t *)user_data;
+  if (timing->has_rt) {
+    realtime_apply(&timing->rt, "timing");
+  }
+
+  guint64 count = 0;
+  while (!__atomic_load_n(&timing->quit, __ATOMIC_ACQUIRE)) {
+    guint64 expirations;
+    if (read(timing->timer_fd, &expirations, sizeof(expirations)) !=
+        sizeof(expirations)) {
+      if (errno == EINTR) {
+        continue;
+      }
+      g_printerr("Timing thread failed to read its timer: %s\n",
+          g_strerror(errno));
+      break;
+    }
+    // Report when the tick was due, so that a late wakeup doesn't move the
+    // bar late too.
+    count += expirations;
+    publish(timing, timing->start_time + count * timing->interval_us, count);
+    guint64 one = 1;
+    if (write(timing->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+      g_printerr("Timing thread failed to signal a tick: %s\n",
+          g_strerror(errno));
+    }
+  }
+  return NULL;
+}
+
+struct timing_thread_t *timing_thread_new(gint64 interval_us,
+    const struct realtime_t *rt) {
+  struct timing_thread_t *timing = g_new0(struct timing_thread_t, 1);
+  timing->interval_us = interval_us;
+  if (rt) {
+    timing->has_rt = TRUE;
+    timing->rt = *rt;
+  }
+  timing->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  timing->event_fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+  if (timing->timer_fd < 0 || timing->event_fd < 0) {
+    g_printerr("Cannot create the timing thread's file descriptors: %s\n",
+        g_strerror(errno));
+    timing_thread_free(timing);
+    return NULL;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  timing->start_time = timespec_to_us(&now);
+  timing->tick.time = timing->start_time;
+  // Absolute expirations at start_time + n * interval_us, so they don't
+  // drift however late the thread wakes.
+  struct itimerspec spec = {
+    us_to_timespec(interval_us),
+    us_to_timespec(timing->start_time + interval_us),
+  };
+  timerfd_settime(timing->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+  timing->thread = g_thread_new("timing", &timing_thread, timing);
+  return timing;
+}
+
+void timing_thread_free(struct timing_thread_t *timing) {
+  if (timing->thread) {
+    // The thread notices within one tick.
+    __atomic_store_n(&timing->quit, TRUE, __ATOMIC_RELEASE);
+    g_thread_join(timing->thread);
+  }
+  if (timing->timer_fd >= 0) {
+    close(timing->timer_fd);
+  }
+  if (timing->event_fd >= 0) {
+    close(timing->event_fd);
+  }
+  g_free(timing);
+}
+
+int timing_thread_get_fd(const struct timing_thread_t *timing) {
+  return timing->event_fd;
+}
+
+void timing_thread_read(struct timing_thread_t *timing,
+    struct timing_tick_t *tick) {
+  // The eventfd is nonblocking, so this fails with EAGAIN if no tick is
+  // pending.
+  guint64 pending;
+  if (read(timing->event_fd, &pending, sizeof(pending)) < 0 &&
+      errno != EAGAIN) {
+    g_printerr("Cannot reset the timing eventfd: %s\n", g_strerror(errno));
+  }
+  guint seq;
+  do {
+    seq = __atomic_load_n(&timing->seq, __ATOMIC_ACQUIRE);
+    tick->time = __atomic_load_n(&timing->tick.time, __ATOMIC_RELAXED);
+    tick->count = __atomic_load_n(&timing->tick.count, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((seq & 1) || seq != __atomic_load_n(&timing->seq,
+      __ATOMIC_RELAXED));
+}
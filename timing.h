@@ -0,0 +1,52 @@
+// A thread that keeps time for the sweep independently of the GTK main loop.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#ifndef TIMING_H_
+#define TIMING_H_
+
+#include <glib.h>
+
+#include "realtime.h"
+
+struct timing_thread_t;
+
+// The latest tick published by the timing thread.
+struct timing_tick_t {
+  // When the tick was due (not when the thread woke up), in microseconds on
+  // the CLOCK_MONOTONIC timebase of frame times.
+  gint64 time;
+  // Ticks since the thread started, including any it slept through.
+  guint64 count;
+};
+
+// Starts a thread that ticks every interval_us microseconds with a
+// CLOCK_MONOTONIC timerfd. If rt isn't NULL, the thread applies it to itself,
+// and carries on with whatever settings it isn't permitted.
+struct timing_thread_t *timing_thread_new(gint64 interval_us,
+    const struct realtime_t *rt);
+void timing_thread_free(struct timing_thread_t *timing);
+
+// Returns an eventfd that becomes readable after each tick, for a GSource.
+int timing_thread_get_fd(const struct timing_thread_t *timing);
+// Returns the latest tick without locking, and resets the eventfd. Ticks
+// published while the caller was busy are coalesced into the latest one.
+void timing_thread_read(struct timing_thread_t *timing,
+    struct timing_tick_t *tick);
+
+#endif  // TIMING_H_
@@ -0,0 +1,116 @@
+// Real and virtual time.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <assert.h>
+
+#include "vclock.h"
+
+struct vclock_timeout_t {
+  guint id;
+  gint64 due;
+  gint64 interval;
+  GSourceFunc func;
+  gpointer user_data;
+};
+
+// Whether the clock is virtual, and if so, its time.
+static gboolean is_virtual = FALSE;
+static gint64 virtual_time = 0;
+// Pending virtual timeouts, soonest first.
+static GList *timeouts = NULL;
+static guint next_id = 1;
+// The virtual timeout being dispatched, and whether it removed itself.
+static struct vclock_timeout_t *dispatching = NULL;
+static gboolean dispatching_removed = FALSE;
+
+static gint compare_due(gconstpointer a, gconstpointer b) {
+  const struct vclock_timeout_t *x = (const struct vclock_timeout_t *)a;
+  const struct vclock_timeout_t *y = (const struct vclock_timeout_t *)b;
+  // Timeouts due at the same time run in the order they were added.
+  if (x->due != y->due) {
+    return x->due < y->due ? -1 : 1;
+  }
+  return x->id < y->id ? -1 : x->id > y->id;
+}
+
+gint64 vclock_get_time(void) {
+  return is_virtual ? virtual_time : g_get_monotonic_time();
+}
+
+guint vclock_add_timeout(gint64 interval_us, GSourceFunc func,
+    gpointer user_data) {
+  if (!is_virtual) {
+    return g_timeout_add(MAX(1, interval_us / 1000), func, user_data);
+  }
+  struct vclock_timeout_t *timeout = g_new(struct vclock_timeout_t, 1);
+  timeout->id = next_id++;
+  timeout->due = virtual_time + interval_us;
+  timeout->interval = interval_us;
+  timeout->func = func;
+  timeout->user_data = user_data;
+  timeouts = g_list_insert_sorted(timeouts, timeout, &compare_due);
+  return timeout->id;
+}
+
+void vclock_remove_timeout(guint id) {
+  if (!is_virtual) {
+    g_source_remove(id);
+    return;
+  }
+  if (dispatching && dispatching->id == id) {
+    dispatching_removed = TRUE;
+    return;
+  }
+  for (GList *l = timeouts; l; l = l->next) {
+    struct vclock_timeout_t *timeout = (struct vclock_timeout_t *)l->data;
+    if (timeout->id == id) {
+      timeouts = g_list_delete_link(timeouts, l);
+      g_free(timeout);
+      return;
+    }
+  }
+}
+
+void vclock_use_virtual(gint64 start_time) {
+  assert(!timeouts);
+  is_virtual = TRUE;
+  virtual_time = start_time;
+}
+
+void vclock_advance_to(gint64 time) {
+  assert(is_virtual);
+  while (timeouts &&
+      ((struct vclock_timeout_t *)timeouts->data)->due <= time) {
+    struct vclock_timeout_t *timeout =
+        (struct vclock_timeout_t *)timeouts->data;
+    timeouts = g_list_delete_link(timeouts, timeouts);
+    virtual_time = timeout->due;
+    dispatching = timeout;
+    dispatching_removed = FALSE;
+    gboolean again = timeout->func(timeout->user_data);
+    dispatching = NULL;
+    if (again && !dispatching_removed) {
+      timeout->due += timeout->interval;
+      timeouts = g_list_insert_sorted(timeouts, timeout, &compare_due);
+    } else {
+      g_free(timeout);
+    }
+  }
+  virtual_time = MAX(virtual_time, time);
+}
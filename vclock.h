@@ -0,0 +1,45 @@
+// Clock for the program's timers, which can be switched to virtual time.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#ifndef VCLOCK_H_
+#define VCLOCK_H_
+
+#include <glib.h>
+
+// Timers go through this rather than the GLib main loop directly, so that a
+// simulation can run them against a virtual clock that only moves when it is
+// advanced. By default the clock is GLib's monotonic clock and timeouts are
+// main loop sources.
+
+// Returns the current time in microseconds.
+gint64 vclock_get_time(void);
+// Like g_timeout_add(), but with the interval in microseconds. Returns an ID
+// for vclock_remove_timeout().
+guint vclock_add_timeout(gint64 interval_us, GSourceFunc func,
+    gpointer user_data);
+void vclock_remove_timeout(guint id);
+
+// Switches to virtual time, starting at start_time. Must be called before any
+// timeout is added.
+void vclock_use_virtual(gint64 start_time);
+// Moves virtual time forward to time, dispatching each timeout that falls due
+// on the way at the time it is due, in order.
+void vclock_advance_to(gint64 time);
+
+#endif  // VCLOCK_H_
@@ -0,0 +1,460 @@
+// Backend that renders into wl_shm buffers of its own Wayland subsurface,
+// paced by frame callbacks and committing only the damaged columns.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+// For memfd_create().
+#define _GNU_SOURCE
+
+#include <gdk/gdkwayland.h>
+#include <glib-unix.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#include "idle-inhibit-unstable-v1-client-protocol.h"
+#include "plasmacleaner.h"
+#include "render_pool.h"
+#include "spanfill.h"
+
+// Frames are double-buffered: one buffer is rendered while the compositor
+// may still be reading the other.
+#define WAYLAND_BUFFERS 2
+
+// Globals bound on an event queue of our own, so that we dispatch the events
+// of everything created from them rather than GDK.
+struct wayland_globals_t {
+  struct wl_display *display;
+  struct wl_event_queue *queue;
+  struct wl_compositor *compositor;
+  struct wl_subcompositor *subcompositor;
+  struct wl_shm *shm;
+  struct zwp_idle_inhibit_manager_v1 *idle_inhibit_manager;
+};
+
+struct wayland_buffer_t {
+  struct wl_buffer *buffer;
+  guint32 *pixels;
+  // Set from commit until the compositor releases the buffer.
+  gboolean busy;
+  // Where the bar is in the buffer's contents, or -1 if they are undefined.
+  int x;
+};
+
+struct wayland_t {
+  struct data_t *data;
+  struct wayland_globals_t *globals;
+  // Dispatches our queue whenever the display has events, since GDK reads
+  // them into it but never dispatches it.
+  guint dispatch_source_id;
+  // A subsurface covering the GTK window. GTK never paints into it, and it
+  // has an empty input region so that input goes to the GTK window.
+  struct wl_surface *surface;
+  struct wl_subsurface *subsurface;
+  // Requested with each commit, and NULL once the compositor has shown it.
+  struct wl_callback *frame_callback;
+  struct wayland_buffer_t buffers[WAYLAND_BUFFERS];
+  // The shared memory holding all the buffers.
+  void *memory;
+  size_t size;
+  // Buffer size in device pixels, and the scale from the window's size.
+  int width;
+  int height;
+  int scale;
+  // Where the bar is in the last committed frame, or -1 if none.
+  int shown_x;
+  // Set when a tick's frame couldn't be committed because the compositor
+  // wasn't ready for it. It is committed as soon as the compositor is.
+  gboolean pending;
+  // Pixel values of the pattern's colours.
+  guint32 palette[MAX_PATTERN_COLOURS];
+  // The pattern compiled for the buffer size, which differs from the
+  // window's with a scale factor.
+  struct span_program_t program;
+  struct render_pool_t *pool;
+
+  // The frame being rendered by render_band(), and storage for one made of
+  // just the damaged parts of a pattern that scrolls. Damage is only tracked
+  // for rows of up to MAX_DAMAGE_RECTS / 2 spans, which scroll into at most
+  // one more.
+  guint32 *pixels;
+  const struct pattern_frame_t *frame;
+  struct span_t spans[MAX_DAMAGE_RECTS * (MAX_DAMAGE_RECTS / 2 + 1)];
+  struct band_t band;
+  struct pattern_frame_t damage_frame;
+};
+
+static struct wayland_globals_t globals;
+// Set by wayland_inhibit_idle().
+static struct zwp_idle_inhibitor_v1 *idle_inhibitor;
+
+static void on_registry_global(void *user_data, struct wl_registry *registry,
+    uint32_t name, const char *interface, uint32_t version) {
+  if (!strcmp(interface, wl_compositor_interface.name) && version >= 4) {
+    // Version 4 is the first with wl_surface.damage_buffer.
+    globals.compositor = wl_registry_bind(registry, name,
+        &wl_compositor_interface, 4);
+  } else if (!strcmp(interface, wl_subcompositor_interface.name)) {
+    globals.subcompositor = wl_registry_bind(registry, name,
+        &wl_subcompositor_interface, 1);
+  } else if (!strcmp(interface, wl_shm_interface.name)) {
+    globals.shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+  } else if (!strcmp(interface,
+      zwp_idle_inhibit_manager_v1_interface.name)) {
+    globals.idle_inhibit_manager = wl_registry_bind(registry, name,
+        &zwp_idle_inhibit_manager_v1_interface, 1);
+  }
+}
+
+static void on_registry_global_remove(void *user_data,
+    struct wl_registry *registry, uint32_t name) {
+}
+
+static const struct wl_registry_listener REGISTRY_LISTENER = {
+  &on_registry_global,
+  &on_registry_global_remove,
+};
+
+// Returns the globals of gdk_display, binding them the first time, or NULL
+// if it is not a Wayland display.
+static struct wayland_globals_t *get_globals(GdkDisplay *gdk_display) {
+  if (!GDK_IS_WAYLAND_DISPLAY(gdk_display)) {
+    return NULL;
+  }
+  if (!globals.display) {
+    globals.display = gdk_wayland_display_get_wl_display(gdk_display);
+    globals.queue = wl_display_create_queue(globals.display);
+    // Create the registry through a wrapper so that none of its events can
+    // be dispatched on GDK's queue.
+    struct wl_display *wrapper = wl_proxy_create_wrapper(globals.display);
+    wl_proxy_set_queue((struct wl_proxy *)wrapper, globals.queue);
+    struct wl_registry *registry = wl_display_get_registry(wrapper);
+    wl_proxy_wrapper_destroy(wrapper);
+    wl_registry_add_listener(registry, &REGISTRY_LISTENER, NULL);
+    wl_display_roundtrip_queue(globals.display, globals.queue);
+    wl_registry_destroy(registry);
+  }
+  return &globals;
+}
+
+static void present_frame(struct wayland_t *wl);
+
+static void on_buffer_release(void *user_data, struct wl_buffer *wl_buffer) {
+  struct wayland_t *wl = (struct wayland_t *)user_data;
+  for (int i = 0; i < WAYLAND_BUFFERS; ++i) {
+    if (wl->buffers[i].buffer == wl_buffer) {
+      wl->buffers[i].busy = FALSE;
+    }
+  }
+  if (wl->pending) {
+    present_frame(wl);
+  }
+}
+
+static const struct wl_buffer_listener BUFFER_LISTENER = {
+  &on_buffer_release,
+};
+
+static void on_frame_done(void *user_data, struct wl_callback *callback,
+    uint32_t time) {
+  struct wayland_t *wl = (struct wayland_t *)user_data;
+  wl_callback_destroy(callback);
+  wl->frame_callback = NULL;
+  if (wl->pending) {
+    present_frame(wl);
+  }
+}
+
+static const struct wl_callback_listener FRAME_LISTENER = {
+  &on_frame_done,
+};
+
+static void render_band(gpointer user_data, int y, int height) {
+  struct wayland_t *wl = (struct wayland_t *)user_data;
+  spanfill_frame(wl->pixels, wl->width * 4, PIXEL_FORMAT_X8R8G8B8, y, height,
+      wl->frame, wl->palette);
+}
+
+static void free_buffers(struct wayland_t *wl) {
+  for (int i = 0; i < WAYLAND_BUFFERS; ++i) {
+    if (wl->buffers[i].buffer) {
+      wl_buffer_destroy(wl->buffers[i].buffer);
+    }
+  }
+  memset(wl->buffers, 0, sizeof(wl->buffers));
+  if (wl->memory) {
+    munmap(wl->memory, wl->size);
+    wl->memory = NULL;
+  }
+  wl->width = 0;
+  wl->height = 0;
+}
+
+// Allocates buffers of the given size in one shared memory pool.
+static gboolean alloc_buffers(struct wayland_t *wl, int width, int height) {
+  size_t frame_size = (size_t)width * height * 4;
+  size_t size = frame_size * WAYLAND_BUFFERS;
+  int fd = memfd_create("plasmacleaner", MFD_CLOEXEC);
+  if (fd < 0) {
+    return FALSE;
+  }
+  if (ftruncate(fd, size) < 0) {
+    close(fd);
+    return FALSE;
+  }
+  void *memory = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if (memory == MAP_FAILED) {
+    close(fd);
+    return FALSE;
+  }
+
+  struct wl_shm_pool *pool = wl_shm_create_pool(wl->globals->shm, fd, size);
+  for (int i = 0; i < WAYLAND_BUFFERS; ++i) {
+    struct wayland_buffer_t *buffer = &wl->buffers[i];
+    buffer->buffer = wl_shm_pool_create_buffer(pool, i * frame_size, width,
+        height, width * 4, WL_SHM_FORMAT_XRGB8888);
+    wl_buffer_add_listener(buffer->buffer, &BUFFER_LISTENER, wl);
+    buffer->pixels = (guint32 *)((char *)memory + i * frame_size);
+    buffer->x = -1;
+  }
+  // The buffers keep the pool's memory alive on the compositor's side.
+  wl_shm_pool_destroy(pool);
+  close(fd);
+
+  wl->memory = memory;
+  wl->size = size;
+  wl->width = width;
+  wl->height = height;
+  wl->shown_x = -1;
+  return TRUE;
+}
+
+// Appends the parts of band's spans within columns [x, x + width) to
+// wl->band.
+static void add_clipped_spans(struct wayland_t *wl,
+    const struct band_t *band, int x, int width) {
+  for (int i = 0; i < band->n_spans; ++i) {
+    const struct span_t *span = &band->spans[i];
+    int x0 = MAX(span->x, x);
+    int x1 = MIN(span->x + span->len, x + width);
+    if (x0 < x1) {
+      wl->spans[wl->band.n_spans++] = (struct span_t){ x0, x1 - x0,
+          span->colour };
+    }
+  }
+}
+
+static void wayland_destroy(struct data_t *data) {
+  struct wayland_t *wl = (struct wayland_t *)data->backend_data;
+  if (!wl) {
+    return;
+  }
+  if (wl->dispatch_source_id) {
+    g_source_remove(wl->dispatch_source_id);
+  }
+  if (wl->frame_callback) {
+    wl_callback_destroy(wl->frame_callback);
+  }
+  free_buffers(wl);
+  if (wl->subsurface) {
+    wl_subsurface_destroy(wl->subsurface);
+  }
+  if (wl->surface) {
+    wl_surface_destroy(wl->surface);
+  }
+  if (wl->globals) {
+    wl_display_flush(wl->globals->display);
+  }
+  if (wl->pool) {
+    render_pool_free(wl->pool);
+  }
+  span_program_free(&wl->program);
+  g_free(wl);
+  data->backend_data = NULL;
+}
+
+// GDK reads the display's events in the main loop's check phase, before any
+// source is dispatched, so the events for our queue are queued by then.
+static gboolean on_display_readable(gint fd, GIOCondition condition,
+    gpointer user_data) {
+  struct wayland_t *wl = (struct wayland_t *)user_data;
+  wl_display_dispatch_queue_pending(wl->globals->display, wl->globals->queue);
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean wayland_init(struct data_t *data) {
+  struct wayland_t *wl = g_new0(struct wayland_t, 1);
+  data->backend_data = wl;
+  wl->data = data;
+  wl->globals = get_globals(gtk_widget_get_display(data->window));
+  if (!wl->globals) {
+    g_printerr("The %s backend requires a Wayland display\n",
+        data->backend->name);
+    wayland_destroy(data);
+    return FALSE;
+  }
+  if (!wl->globals->compositor || !wl->globals->subcompositor ||
+      !wl->globals->shm) {
+    g_printerr("The compositor lacks wl_compositor 4, wl_subcompositor or "
+        "wl_shm\n");
+    wayland_destroy(data);
+    return FALSE;
+  }
+
+  struct wl_surface *parent = gdk_wayland_window_get_wl_surface(
+      gtk_widget_get_window(data->window));
+  wl->surface = wl_compositor_create_surface(wl->globals->compositor);
+  wl->subsurface = wl_subcompositor_get_subsurface(wl->globals->subcompositor,
+      wl->surface, parent);
+  wl_subsurface_set_position(wl->subsurface, 0, 0);
+  // Our commits take effect without waiting for GTK to commit the parent.
+  wl_subsurface_set_desync(wl->subsurface);
+  struct wl_region *region = wl_compositor_create_region(
+      wl->globals->compositor);
+  wl_surface_set_input_region(wl->surface, region);
+  wl_region_destroy(region);
+
+  for (int i = 0; i < data->pattern->n_colours; ++i) {
+    const struct colour_t *c = &data->pattern->colours[i];
+    wl->palette[i] = pixel_format_pack(PIXEL_FORMAT_X8R8G8B8, c->r, c->g,
+        c->b);
+  }
+  wl->pool = render_pool_new(data->threads, data->realtime);
+  wl->shown_x = -1;
+  wl->dispatch_source_id = g_unix_fd_add(
+      wl_display_get_fd(wl->globals->display), G_IO_IN, &on_display_readable,
+      wl);
+  return TRUE;
+}
+
+// Renders and commits the frame for data->x into a free buffer if the
+// compositor has shown the last frame, and otherwise leaves it pending.
+static void present_frame(struct wayland_t *wl) {
+  struct wayland_buffer_t *buffer = NULL;
+  for (int i = 0; i < WAYLAND_BUFFERS && !buffer; ++i) {
+    if (!wl->buffers[i].busy) {
+      buffer = &wl->buffers[i];
+    }
+  }
+  if (wl->frame_callback || !buffer) {
+    wl->pending = TRUE;
+    return;
+  }
+  wl->pending = FALSE;
+
+  // Repaint only the columns that differ from the buffer's old contents.
+  int width = wl->width;
+  int height = wl->height;
+  int x = (int)wl->data->x * wl->scale;
+  span_program_compile(&wl->program, wl->data->pattern, width, height);
+  const struct pattern_frame_t *frame = span_program_run(&wl->program, x);
+  cairo_rectangle_int_t rects[MAX_DAMAGE_RECTS];
+  int n = buffer->x < 0 ? -1 :
+      span_program_get_damage(&wl->program, buffer->x, x, rects);
+  if (n < 0) {
+    wl->frame = frame;
+  } else {
+    wl->band = (struct band_t){ 0, height, wl->spans, 0 };
+    for (int i = 0; i < n; ++i) {
+      add_clipped_spans(wl, &frame->bands[0], rects[i].x, rects[i].width);
+    }
+    wl->damage_frame = (struct pattern_frame_t){ &wl->band, 1 };
+    wl->frame = &wl->damage_frame;
+  }
+  wl->pixels = buffer->pixels;
+  render_pool_run(wl->pool, height, &render_band, wl);
+  buffer->x = x;
+
+  // Damage only what differs from the frame on screen.
+  wl_surface_attach(wl->surface, buffer->buffer, 0, 0);
+  n = wl->shown_x < 0 ? -1 :
+      span_program_get_damage(&wl->program, wl->shown_x, x, rects);
+  if (n < 0) {
+    wl_surface_damage_buffer(wl->surface, 0, 0, width, height);
+  } else {
+    for (int i = 0; i < n; ++i) {
+      wl_surface_damage_buffer(wl->surface, rects[i].x, rects[i].y,
+          rects[i].width, rects[i].height);
+    }
+  }
+  wl->frame_callback = wl_surface_frame(wl->surface);
+  wl_callback_add_listener(wl->frame_callback, &FRAME_LISTENER, wl);
+  wl_surface_commit(wl->surface);
+  buffer->busy = TRUE;
+  wl->shown_x = x;
+  wl_display_flush(wl->globals->display);
+}
+
+static void wayland_update(struct data_t *data, int old_x, gboolean full) {
+  struct wayland_t *wl = (struct wayland_t *)data->backend_data;
+  int scale = gtk_widget_get_scale_factor(data->window);
+  int width = MAX(data->width, 1) * scale;
+  int height = MAX(data->height, 1) * scale;
+  if (width != wl->width || height != wl->height) {
+    free_buffers(wl);
+    if (!alloc_buffers(wl, width, height)) {
+      g_printerr("Cannot allocate shared memory buffers\n");
+      gtk_widget_destroy(data->window);
+      return;
+    }
+    wl->scale = scale;
+    wl_surface_set_buffer_scale(wl->surface, scale);
+    struct wl_region *region = wl_compositor_create_region(
+        wl->globals->compositor);
+    wl_region_add(region, 0, 0, data->width, data->height);
+    wl_surface_set_opaque_region(wl->surface, region);
+    wl_region_destroy(region);
+  }
+
+  // A frame still pending from an earlier tick is superseded by this one.
+  if (wl->pending) {
+    ++data->stats.dropped_frames;
+  }
+  present_frame(wl);
+}
+
+const struct backend_t WAYLAND_BACKEND = {
+  "wayland",
+  "render into wl_shm buffers of a Wayland subsurface",
+  &wayland_init,
+  &wayland_update,
+  &wayland_destroy,
+  FALSE,
+};
+
+gboolean wayland_inhibit_idle(GtkWidget *window) {
+  struct wayland_globals_t *globals = get_globals(
+      gtk_widget_get_display(window));
+  if (!globals || !globals->idle_inhibit_manager) {
+    return FALSE;
+  }
+  idle_inhibitor = zwp_idle_inhibit_manager_v1_create_inhibitor(
+      globals->idle_inhibit_manager,
+      gdk_wayland_window_get_wl_surface(gtk_widget_get_window(window)));
+  wl_display_flush(globals->display);
+  return TRUE;
+}
+
+void wayland_uninhibit_idle(void) {
+  if (idle_inhibitor) {
+    zwp_idle_inhibitor_v1_destroy(idle_inhibitor);
+    idle_inhibitor = NULL;
+    wl_display_flush(globals.display);
+  }
+}
@@ -0,0 +1,309 @@
+// Helpers shared by the backends that draw with Xlib into their own window.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <X11/Xutil.h>
+
+#include "x11.h"
+
+static GdkFilterReturn on_x11_event(GdkXEvent *gdk_xevent, GdkEvent *event,
+    gpointer user_data) {
+  struct x11_window_t *xw = (struct x11_window_t *)user_data;
+  XEvent *xevent = (XEvent *)gdk_xevent;
+  if (xevent->type != Expose || xevent->xexpose.window != xw->window) {
+    return GDK_FILTER_CONTINUE;
+  }
+  xw->data->damaged = TRUE;
+  return GDK_FILTER_REMOVE;
+}
+
+gboolean x11_window_init(struct x11_window_t *xw, struct data_t *data) {
+  GdkDisplay *gdk_display = gtk_widget_get_display(data->window);
+  if (!GDK_IS_X11_DISPLAY(gdk_display)) {
+    g_printerr("The %s backend requires an X11 display\n",
+        data->backend->name);
+    return FALSE;
+  }
+
+  xw->data = data;
+  xw->display = gdk_x11_display_get_xdisplay(gdk_display);
+  Window parent = gdk_x11_window_get_xid(gtk_widget_get_window(data->window));
+  XWindowAttributes parent_attributes;
+  XGetWindowAttributes(xw->display, parent, &parent_attributes);
+  xw->visual = parent_attributes.visual;
+  xw->depth = parent_attributes.depth;
+  if (xw->visual->class != TrueColor) {
+    g_printerr("The %s backend requires a TrueColor visual\n",
+        data->backend->name);
+    return FALSE;
+  }
+
+  xw->width = MAX(data->width, 1);
+  xw->height = MAX(data->height, 1);
+  // No background, so that the server doesn't clear what we drew on exposes,
+  // and only ExposureMask, so that input goes to the GTK window.
+  XSetWindowAttributes attributes;
+  attributes.background_pixmap = None;
+  attributes.event_mask = ExposureMask;
+  xw->window = XCreateWindow(xw->display, parent, 0, 0, xw->width, xw->height,
+      0, xw->depth, InputOutput, xw->visual, CWBackPixmap|CWEventMask,
+      &attributes);
+  gdk_window_add_filter(NULL, &on_x11_event, xw);
+  XMapWindow(xw->display, xw->window);
+  return TRUE;
+}
+
+gboolean x11_window_update_size(struct x11_window_t *xw) {
+  int width = MAX(xw->data->width, 1);
+  int height = MAX(xw->data->height, 1);
+  if (width == xw->width && height == xw->height) {
+    return FALSE;
+  }
+  XResizeWindow(xw->display, xw->window, width, height);
+  xw->width = width;
+  xw->height = height;
+  return TRUE;
+}
+
+void x11_window_destroy(struct x11_window_t *xw) {
+  g_free(xw->rects);
+  xw->rects = NULL;
+  xw->max_rects = 0;
+  if (!xw->window) {
+    return;
+  }
+  gdk_window_remove_filter(NULL, &on_x11_event, xw);
+  XDestroyWindow(xw->display, xw->window);
+  xw->window = None;
+}
+
+size_t x11_fill_frame(struct x11_window_t *xw, Drawable drawable,
+    const GC *gcs, const struct pattern_frame_t *frame,
+    const XRectangle *clip) {
+  // Rectangles are grouped by colour: rects[first[c]] onwards are colour c's.
+  int first[MAX_PATTERN_COLOURS + 1] = { 0 };
+  for (int i = 0; i < frame->n_bands; ++i) {
+    for (int j = 0; j < frame->bands[i].n_spans; ++j) {
+      ++first[frame->bands[i].spans[j].colour + 1];
+    }
+  }
+  for (int colour = 0; colour < MAX_PATTERN_COLOURS; ++colour) {
+    first[colour + 1] += first[colour];
+  }
+  // The span count only changes with the screen size, so this rarely grows.
+  if (first[MAX_PATTERN_COLOURS] > xw->max_rects) {
+    xw->max_rects = first[MAX_PATTERN_COLOURS];
+    xw->rects = g_renew(XRectangle, xw->rects, xw->max_rects);
+  }
+  XRectangle *rects = xw->rects;
+  int n_rects[MAX_PATTERN_COLOURS] = { 0 };
+
+  int clip_right = clip->x + clip->width;
+  int clip_bottom = clip->y + clip->height;
+  for (int i = 0; i < frame->n_bands; ++i) {
+    const struct band_t *band = &frame->bands[i];
+    int y0 = MAX(band->y, clip->y);
+    int y1 = MIN(band->y + band->height, clip_bottom);
+    if (y0 >= y1) {
+      continue;
+    }
+    for (int j = 0; j < band->n_spans; ++j) {
+      const struct span_t *span = &band->spans[j];
+      int x0 = MAX(span->x, clip->x);
+      int x1 = MIN(span->x + span->len, clip_right);
+      if (x0 >= x1) {
+        continue;
+      }
+      rects[first[span->colour] + n_rects[span->colour]++] =
+          (XRectangle){ x0, y0, x1 - x0, y1 - y0 };
+    }
+  }
+  size_t bytes = 0;
+  for (int colour = 0; colour < MAX_PATTERN_COLOURS; ++colour) {
+    if (n_rects[colour]) {
+      XFillRectangles(xw->display, drawable, gcs[colour],
+          rects + first[colour], n_rects[colour]);
+      bytes += X11_FILL_RECTANGLES_BYTES(n_rects[colour]);
+    }
+  }
+  return bytes;
+}
+
+gboolean x11_strip_init(struct x11_strip_t *strip, struct data_t *data,
+    enum x11_strip_orientation_t orientation) {
+  strip->orientation = orientation;
+  struct x11_window_t *xw = &strip->xw;
+  if (!x11_window_init(xw, data) ||
+      !x11_get_pixel_format(xw, &strip->pixel_format)) {
+    return FALSE;
+  }
+  int event_base, error_base;
+  if (!XRenderQueryExtension(xw->display, &event_base, &error_base)) {
+    g_printerr("The X server does not support RENDER\n");
+    return FALSE;
+  }
+  strip->format = XRenderFindVisualFormat(xw->display, xw->visual);
+  if (!strip->format) {
+    g_printerr("No RENDER format for the window's visual\n");
+    return FALSE;
+  }
+  strip->window_picture = XRenderCreatePicture(xw->display, xw->window,
+      strip->format, 0, NULL);
+  strip->gc = XCreateGC(xw->display, xw->window, 0, NULL);
+  for (int i = 0; i < data->pattern->n_colours; ++i) {
+    const struct colour_t *c = &data->pattern->colours[i];
+    strip->palette[i] = x11_get_pixel(xw->visual, c->r, c->g, c->b);
+  }
+  return TRUE;
+}
+
+static void free_strip_image(struct x11_strip_t *strip) {
+  if (strip->picture) {
+    XRenderFreePicture(strip->xw.display, strip->picture);
+    XFreePixmap(strip->xw.display, strip->pixmap);
+    strip->picture = None;
+    strip->pixmap = None;
+  }
+  if (strip->image) {
+    // The pixels are ours to free, not Xlib's.
+    g_free(strip->image->data);
+    strip->image->data = NULL;
+    XDestroyImage(strip->image);
+    strip->image = NULL;
+  }
+}
+
+void x11_strip_destroy(struct x11_strip_t *strip) {
+  if (strip->xw.window) {
+    free_strip_image(strip);
+    if (strip->gc) {
+      XFreeGC(strip->xw.display, strip->gc);
+    }
+    if (strip->window_picture) {
+      XRenderFreePicture(strip->xw.display, strip->window_picture);
+    }
+  }
+  x11_window_destroy(&strip->xw);
+}
+
+gboolean x11_strip_update_size(struct x11_strip_t *strip) {
+  struct x11_window_t *xw = &strip->xw;
+  x11_window_update_size(xw);
+  int width = strip->orientation == X11_STRIP_ROW ? xw->width : 1;
+  int height = strip->orientation == X11_STRIP_ROW ? 1 : xw->height;
+  if (strip->image && strip->image->width == width &&
+      strip->image->height == height) {
+    return TRUE;
+  }
+  free_strip_image(strip);
+
+  // Xlib pads each line to 32 bits, so a column takes 4 bytes per pixel
+  // whatever the depth.
+  strip->image = XCreateImage(xw->display, xw->visual, xw->depth, ZPixmap, 0,
+      NULL, width, height, 32, 0);
+  strip->image->data = g_malloc((size_t)strip->image->bytes_per_line *
+      height);
+  if (strip->image->bits_per_pixel !=
+      pixel_format_get_bytes(strip->pixel_format) * 8) {
+    g_printerr("Unsupported image layout (%d bpp)\n",
+        strip->image->bits_per_pixel);
+    free_strip_image(strip);
+    return FALSE;
+  }
+  strip->pixmap = XCreatePixmap(xw->display, xw->window, width, height,
+      xw->depth);
+  XRenderPictureAttributes attributes;
+  attributes.repeat = RepeatNormal;
+  strip->picture = XRenderCreatePicture(xw->display, strip->pixmap,
+      strip->format, CPRepeat, &attributes);
+  return TRUE;
+}
+
+size_t x11_strip_put(struct x11_strip_t *strip) {
+  XImage *image = strip->image;
+  XPutImage(strip->xw.display, strip->pixmap, strip->gc, image, 0, 0, 0, 0,
+      image->width, image->height);
+  return X11_PUT_IMAGE_BYTES + (size_t)image->bytes_per_line * image->height;
+}
+
+size_t x11_strip_composite(struct x11_strip_t *strip, int x, int y,
+    int width, int height) {
+  // The source repeats, so it can be sampled at the destination's
+  // coordinates.
+  XRenderComposite(strip->xw.display, PictOpSrc, strip->picture, None,
+      strip->window_picture, x, y, 0, 0, x, y, width, height);
+  return XRENDER_COMPOSITE_BYTES;
+}
+
+GC x11_create_fill_gc(struct x11_window_t *xw, double r, double g, double b) {
+  XGCValues values;
+  values.foreground = x11_get_pixel(xw->visual, r, g, b);
+  values.graphics_exposures = False;
+  return XCreateGC(xw->display, xw->window, GCForeground|GCGraphicsExposures,
+      &values);
+}
+
+void x11_create_pattern_gcs(struct x11_window_t *xw,
+    const struct pattern_t *pattern, GC gcs[MAX_PATTERN_COLOURS]) {
+  for (int i = 0; i < pattern->n_colours; ++i) {
+    const struct colour_t *c = &pattern->colours[i];
+    gcs[i] = x11_create_fill_gc(xw, c->r, c->g, c->b);
+  }
+}
+
+void x11_free_pattern_gcs(struct x11_window_t *xw,
+    const struct pattern_t *pattern, GC gcs[MAX_PATTERN_COLOURS]) {
+  for (int i = 0; i < pattern->n_colours; ++i) {
+    XFreeGC(xw->display, gcs[i]);
+  }
+}
+
+static unsigned long scale_to_mask(double value, unsigned long mask) {
+  if (!mask) {
+    return 0;
+  }
+  int shift = __builtin_ctzl(mask);
+  unsigned long max = mask >> shift;
+  return ((unsigned long)(value * max + 0.5) << shift) & mask;
+}
+
+unsigned long x11_get_pixel(const Visual *visual, double r, double g,
+    double b) {
+  return scale_to_mask(r, visual->red_mask) |
+      scale_to_mask(g, visual->green_mask) |
+      scale_to_mask(b, visual->blue_mask);
+}
+
+gboolean x11_get_pixel_format(const struct x11_window_t *xw,
+    enum pixel_format_t *format) {
+  switch (xw->depth) {
+    case 16:
+      *format = PIXEL_FORMAT_R5G6B5;
+      return TRUE;
+    case 24:
+      *format = PIXEL_FORMAT_X8R8G8B8;
+      return TRUE;
+    case 30:
+      *format = PIXEL_FORMAT_A2R10G10B10;
+      return TRUE;
+    default:
+      g_printerr("The %s backend does not support depth %d\n",
+          xw->data->backend->name, xw->depth);
+      return FALSE;
+  }
+}
@@ -0,0 +1,127 @@
+// Helpers shared by the backends that draw with Xlib into their own window.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#ifndef X11_H_
+#define X11_H_
+
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+
+#include "plasmacleaner.h"
+#include "spanfill.h"
+
+// A child window covering the GTK window. GTK never paints into it, so a
+// backend can draw into it directly, while input events still propagate to
+// the GTK window.
+struct x11_window_t {
+  Display *display;
+  Window window;
+  Visual *visual;
+  int depth;
+  int width;
+  int height;
+  // The data_t whose damaged flag is set when the window is exposed.
+  struct data_t *data;
+  // Storage for x11_fill_frame(), kept between frames.
+  XRectangle *rects;
+  int max_rects;
+};
+
+// Creates the child window at data's size. Returns FALSE if data->window is
+// not on an X11 display.
+gboolean x11_window_init(struct x11_window_t *xw, struct data_t *data);
+// Resizes the child window to data's size if it has changed, and returns
+// whether it did.
+gboolean x11_window_update_size(struct x11_window_t *xw);
+void x11_window_destroy(struct x11_window_t *xw);
+
+// Fills the part of frame within clip on drawable, which is on xw's display,
+// with gcs[span.colour] as the colour. Issues at most one XFillRectangles
+// request per GC. Returns the size in bytes of the requests issued.
+size_t x11_fill_frame(struct x11_window_t *xw, Drawable drawable,
+    const GC *gcs, const struct pattern_frame_t *frame,
+    const XRectangle *clip);
+
+// Creates a GC that fills with the given colour.
+GC x11_create_fill_gc(struct x11_window_t *xw, double r, double g, double b);
+// Creates a fill GC for each of pattern's colours, and frees them.
+void x11_create_pattern_gcs(struct x11_window_t *xw,
+    const struct pattern_t *pattern, GC gcs[MAX_PATTERN_COLOURS]);
+void x11_free_pattern_gcs(struct x11_window_t *xw,
+    const struct pattern_t *pattern, GC gcs[MAX_PATTERN_COLOURS]);
+
+// Size in bytes of an XFillRectangles request for n rectangles, of an
+// XCopyArea request, of an XPutImage request without its pixels, and of a
+// RenderComposite request.
+#define X11_FILL_RECTANGLES_BYTES(n) (12 + 8 * (n))
+#define X11_COPY_AREA_BYTES 28
+#define X11_PUT_IMAGE_BYTES 24
+#define XRENDER_COMPOSITE_BYTES 36
+
+// Whether a strip is one row of the window or one column.
+enum x11_strip_orientation_t {
+  X11_STRIP_ROW,
+  X11_STRIP_COLUMN,
+};
+
+// A child window drawn from a single row or column of pixels, rendered in
+// client memory and copied to a server-side picture that repeats in both
+// directions, so that the X server replicates it across the window.
+struct x11_strip_t {
+  struct x11_window_t xw;
+  enum x11_strip_orientation_t orientation;
+  XRenderPictFormat *format;
+  Picture window_picture;
+  GC gc;
+  enum pixel_format_t pixel_format;
+  // Pixel values of the pattern's colours.
+  guint32 palette[MAX_PATTERN_COLOURS];
+  // The strip in client memory, and its copy on the server.
+  XImage *image;
+  Pixmap pixmap;
+  Picture picture;
+};
+
+// Creates the child window for a strip. Returns FALSE with an error printed
+// if RENDER or the window's format isn't supported, in which case the strip
+// must still be destroyed.
+gboolean x11_strip_init(struct x11_strip_t *strip, struct data_t *data,
+    enum x11_strip_orientation_t orientation);
+void x11_strip_destroy(struct x11_strip_t *strip);
+// Resizes the window to data's size and (re-)creates the strip if its length
+// has changed. Returns FALSE with an error printed if that fails.
+gboolean x11_strip_update_size(struct x11_strip_t *strip);
+// Copies the strip to the server, and returns the size of the request.
+size_t x11_strip_put(struct x11_strip_t *strip);
+// Paints a rectangle of the window with the strip repeated, and returns the
+// size of the request.
+size_t x11_strip_composite(struct x11_strip_t *strip, int x, int y,
+    int width, int height);
+
+// Returns the pixel value of an RGB colour for a TrueColor visual.
+unsigned long x11_get_pixel(const Visual *visual, double r, double g,
+    double b);
+
+// Sets *format to the span fill format for the window's depth. Returns FALSE
+// with an error printed if there is none.
+gboolean x11_get_pixel_format(const struct x11_window_t *xw,
+    enum pixel_format_t *format);
+
+#endif  // X11_H_
@@ -0,0 +1,69 @@
+// Backend that draws the bar as plain rectangles with Xlib.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include "x11.h"
+
+struct xlib_t {
+  struct x11_window_t xw;
+  // The pattern's colours.
+  GC gcs[MAX_PATTERN_COLOURS];
+};
+
+static void xlib_destroy(struct data_t *data) {
+  struct xlib_t *xlib = (struct xlib_t *)data->backend_data;
+  if (!xlib) {
+    return;
+  }
+  if (xlib->xw.window) {
+    x11_free_pattern_gcs(&xlib->xw, data->pattern, xlib->gcs);
+    x11_window_destroy(&xlib->xw);
+  }
+  g_free(xlib);
+  data->backend_data = NULL;
+}
+
+static gboolean xlib_init(struct data_t *data) {
+  struct xlib_t *xlib = g_new0(struct xlib_t, 1);
+  data->backend_data = xlib;
+  if (!x11_window_init(&xlib->xw, data)) {
+    xlib_destroy(data);
+    return FALSE;
+  }
+  x11_create_pattern_gcs(&xlib->xw, data->pattern, xlib->gcs);
+  return TRUE;
+}
+
+static void xlib_update(struct data_t *data, int old_x, gboolean full) {
+  struct xlib_t *xlib = (struct xlib_t *)data->backend_data;
+  struct x11_window_t *xw = &xlib->xw;
+  x11_window_update_size(xw);
+  XRectangle clip = { 0, 0, xw->width, xw->height };
+  data->stats.x11_request_bytes += x11_fill_frame(xw, xw->window,
+      xlib->gcs, &data->program.frame, &clip);
+  XFlush(xw->display);
+}
+
+const struct backend_t XLIB_BACKEND = {
+  "xlib",
+  "fill the pattern's spans as rectangles with Xlib",
+  &xlib_init,
+  &xlib_update,
+  &xlib_destroy,
+  FALSE,
+};
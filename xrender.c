@@ -0,0 +1,146 @@
+// Backend that keeps one period of the bar in an XRender picture on the X
+// server and composites it with a new offset each frame, so no pixel data
+// crosses the socket after setup.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+
+#include "x11.h"
+
+struct xrender_t {
+  struct x11_window_t xw;
+  XRenderPictFormat *format;
+  Picture window_picture;
+  // One row of the bar with the bar at x = 0, repeated when composited, and
+  // the width it was made for.
+  Pixmap bar_pixmap;
+  Picture bar_picture;
+  int bar_width;
+  // The pattern's colours.
+  GC gcs[MAX_PATTERN_COLOURS];
+};
+
+static void free_bar_picture(struct xrender_t *xrender) {
+  if (xrender->bar_picture) {
+    XRenderFreePicture(xrender->xw.display, xrender->bar_picture);
+    XFreePixmap(xrender->xw.display, xrender->bar_pixmap);
+    xrender->bar_picture = None;
+    xrender->bar_pixmap = None;
+  }
+}
+
+// (Re-)creates the bar picture if the width has changed.
+static void update_bar_picture(struct xrender_t *xrender, struct data_t *data) {
+  struct x11_window_t *xw = &xrender->xw;
+  if (xrender->bar_picture && xrender->bar_width == xw->width) {
+    return;
+  }
+  free_bar_picture(xrender);
+
+  xrender->bar_pixmap = XCreatePixmap(xw->display, xw->window, xw->width, 1,
+      xw->depth);
+  const struct band_t band = { 0, 1, data->program.row, data->program.n_row };
+  const struct pattern_frame_t row = { &band, 1 };
+  XRectangle clip = { 0, 0, xw->width, 1 };
+  data->stats.x11_request_bytes += x11_fill_frame(xw,
+      xrender->bar_pixmap, xrender->gcs, &row, &clip);
+
+  XRenderPictureAttributes attributes;
+  attributes.repeat = RepeatNormal;
+  xrender->bar_picture = XRenderCreatePicture(xw->display,
+      xrender->bar_pixmap, xrender->format, CPRepeat, &attributes);
+  xrender->bar_width = xw->width;
+}
+
+static void xrender_destroy(struct data_t *data) {
+  struct xrender_t *xrender = (struct xrender_t *)data->backend_data;
+  if (!xrender) {
+    return;
+  }
+  if (xrender->xw.window) {
+    free_bar_picture(xrender);
+    if (xrender->gcs[0]) {
+      x11_free_pattern_gcs(&xrender->xw, data->pattern, xrender->gcs);
+    }
+    if (xrender->window_picture) {
+      XRenderFreePicture(xrender->xw.display, xrender->window_picture);
+    }
+    x11_window_destroy(&xrender->xw);
+  }
+  g_free(xrender);
+  data->backend_data = NULL;
+}
+
+static gboolean xrender_init(struct data_t *data) {
+  struct xrender_t *xrender = g_new0(struct xrender_t, 1);
+  data->backend_data = xrender;
+  if (!x11_window_init(&xrender->xw, data)) {
+    xrender_destroy(data);
+    return FALSE;
+  }
+  Display *display = xrender->xw.display;
+  int event_base, error_base;
+  if (!XRenderQueryExtension(display, &event_base, &error_base)) {
+    g_printerr("The X server does not support RENDER\n");
+    xrender_destroy(data);
+    return FALSE;
+  }
+  xrender->format = XRenderFindVisualFormat(display, xrender->xw.visual);
+  if (!xrender->format) {
+    g_printerr("No RENDER format for the window's visual\n");
+    xrender_destroy(data);
+    return FALSE;
+  }
+  xrender->window_picture = XRenderCreatePicture(display, xrender->xw.window,
+      xrender->format, 0, NULL);
+  x11_create_pattern_gcs(&xrender->xw, data->pattern, xrender->gcs);
+  return TRUE;
+}
+
+static void xrender_update(struct data_t *data, int old_x, gboolean full) {
+  struct xrender_t *xrender = (struct xrender_t *)data->backend_data;
+  struct x11_window_t *xw = &xrender->xw;
+  x11_window_update_size(xw);
+  if (!data->pattern->scrolls) {
+    // There is no one picture to composite, so fill the spans instead.
+    XRectangle clip = { 0, 0, xw->width, xw->height };
+    data->stats.x11_request_bytes += x11_fill_frame(xw, xw->window,
+        xrender->gcs, &data->program.frame, &clip);
+    XFlush(xw->display);
+    return;
+  }
+  update_bar_picture(xrender, data);
+
+  // Window column c shows bar column (c - x) mod width.
+  int src_x = (xw->width - (int)data->x) % xw->width;
+  XRenderComposite(xw->display, PictOpSrc, xrender->bar_picture, None,
+      xrender->window_picture, src_x, 0, 0, 0, 0, 0, xw->width, xw->height);
+  data->stats.x11_request_bytes += XRENDER_COMPOSITE_BYTES;
+  XFlush(xw->display);
+}
+
+const struct backend_t XRENDER_BACKEND = {
+  "xrender",
+  "composite a repeating server-side picture of the bar with XRender",
+  &xrender_init,
+  &xrender_update,
+  &xrender_destroy,
+  FALSE,
+};
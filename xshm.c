@@ -0,0 +1,254 @@
+// Backend that renders into MIT-SHM images, so frames reach the X server
+// without being copied through the socket.
+//
+// Copyright (c) 2012 Tristan Schmelcher <tristan_schmelcher@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+// USA.
+
+#include <errno.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+
+#include "render_pool.h"
+#include "spanfill.h"
+#include "x11.h"
+
+// Frames are double-buffered: one image is rendered while the server may
+// still be reading the other.
+#define XSHM_BUFFERS 2
+
+struct xshm_buffer_t {
+  XImage *image;
+  XShmSegmentInfo segment;
+  // Set from XShmPutImage until the server's completion event.
+  gboolean busy;
+};
+
+struct xshm_t {
+  struct x11_window_t xw;
+  GC gc;
+  int completion_type;
+  struct xshm_buffer_t buffers[XSHM_BUFFERS];
+  int next_buffer;
+  enum pixel_format_t format;
+  // Pixel values of the pattern's colours.
+  guint32 palette[MAX_PATTERN_COLOURS];
+  struct render_pool_t *pool;
+
+  // The frame being rendered by render_band().
+  XImage *image;
+  const struct pattern_frame_t *frame;
+};
+
+static void render_band(gpointer user_data, int y, int height) {
+  struct xshm_t *xshm = (struct xshm_t *)user_data;
+  spanfill_frame(xshm->image->data, xshm->image->bytes_per_line, xshm->format,
+      y, height, xshm->frame, xshm->palette);
+}
+
+static void free_buffer(struct xshm_t *xshm, struct xshm_buffer_t *buffer) {
+  if (!buffer->image) {
+    return;
+  }
+  XShmDetach(xshm->xw.display, &buffer->segment);
+  XDestroyImage(buffer->image);
+  shmdt(buffer->segment.shmaddr);
+  memset(buffer, 0, sizeof(*buffer));
+}
+
+static void free_buffers(struct xshm_t *xshm) {
+  // Make sure the server is done with the segments before detaching.
+  XSync(xshm->xw.display, False);
+  for (int i = 0; i < XSHM_BUFFERS; ++i) {
+    free_buffer(xshm, &xshm->buffers[i]);
+  }
+}
+
+static gboolean alloc_buffer(struct xshm_t *xshm,
+    struct xshm_buffer_t *buffer) {
+  struct x11_window_t *xw = &xshm->xw;
+  buffer->image = XShmCreateImage(xw->display, xw->visual, xw->depth, ZPixmap,
+      NULL, &buffer->segment, xw->width, xw->height);
+  if (!buffer->image) {
+    return FALSE;
+  }
+  int bits_per_pixel = pixel_format_get_bytes(xshm->format) * 8;
+  if (buffer->image->bits_per_pixel != bits_per_pixel) {
+    g_printerr("Unsupported XShm image layout (%d bpp)\n",
+        buffer->image->bits_per_pixel);
+    XDestroyImage(buffer->image);
+    buffer->image = NULL;
+    return FALSE;
+  }
+  buffer->segment.shmid = shmget(IPC_PRIVATE,
+      (size_t)buffer->image->bytes_per_line * buffer->image->height,
+      IPC_CREAT|0600);
+  if (buffer->segment.shmid < 0) {
+    XDestroyImage(buffer->image);
+    buffer->image = NULL;
+    return FALSE;
+  }
+  buffer->segment.shmaddr = shmat(buffer->segment.shmid, NULL, 0);
+  if (buffer->segment.shmaddr == (void *)-1) {
+    g_printerr("shmat failed: %s\n", g_strerror(errno));
+    shmctl(buffer->segment.shmid, IPC_RMID, NULL);
+    XDestroyImage(buffer->image);
+    memset(buffer, 0, sizeof(*buffer));
+    return FALSE;
+  }
+  buffer->image->data = buffer->segment.shmaddr;
+  buffer->segment.readOnly = False;
+
+  gdk_error_trap_push();
+  XShmAttach(xw->display, &buffer->segment);
+  XSync(xw->display, False);
+  gboolean attached = !gdk_error_trap_pop();
+  // The segment is freed once both we and the server have detached.
+  shmctl(buffer->segment.shmid, IPC_RMID, NULL);
+  if (!attached) {
+    g_printerr("XShmAttach failed (is the display remote?)\n");
+    XDestroyImage(buffer->image);
+    shmdt(buffer->segment.shmaddr);
+    memset(buffer, 0, sizeof(*buffer));
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean alloc_buffers(struct xshm_t *xshm) {
+  for (int i = 0; i < XSHM_BUFFERS; ++i) {
+    if (!alloc_buffer(xshm, &xshm->buffers[i])) {
+      free_buffers(xshm);
+      return FALSE;
+    }
+  }
+  xshm->next_buffer = 0;
+  return TRUE;
+}
+
+static GdkFilterReturn on_xshm_event(GdkXEvent *gdk_xevent, GdkEvent *event,
+    gpointer user_data) {
+  struct xshm_t *xshm = (struct xshm_t *)user_data;
+  XEvent *xevent = (XEvent *)gdk_xevent;
+  if (xevent->type != xshm->completion_type) {
+    return GDK_FILTER_CONTINUE;
+  }
+  XShmCompletionEvent *completion = (XShmCompletionEvent *)xevent;
+  for (int i = 0; i < XSHM_BUFFERS; ++i) {
+    if (xshm->buffers[i].image &&
+        xshm->buffers[i].segment.shmseg == completion->shmseg) {
+      xshm->buffers[i].busy = FALSE;
+      return GDK_FILTER_REMOVE;
+    }
+  }
+  return GDK_FILTER_CONTINUE;
+}
+
+static void xshm_destroy(struct data_t *data) {
+  struct xshm_t *xshm = (struct xshm_t *)data->backend_data;
+  if (!xshm) {
+    return;
+  }
+  if (xshm->xw.window) {
+    gdk_window_remove_filter(NULL, &on_xshm_event, xshm);
+    free_buffers(xshm);
+    if (xshm->gc) {
+      XFreeGC(xshm->xw.display, xshm->gc);
+    }
+    x11_window_destroy(&xshm->xw);
+  }
+  if (xshm->pool) {
+    render_pool_free(xshm->pool);
+  }
+  g_free(xshm);
+  data->backend_data = NULL;
+}
+
+static gboolean xshm_init(struct data_t *data) {
+  struct xshm_t *xshm = g_new0(struct xshm_t, 1);
+  data->backend_data = xshm;
+  if (!x11_window_init(&xshm->xw, data)) {
+    xshm_destroy(data);
+    return FALSE;
+  }
+  Display *display = xshm->xw.display;
+  if (!XShmQueryExtension(display)) {
+    g_printerr("The X server does not support MIT-SHM\n");
+    xshm_destroy(data);
+    return FALSE;
+  }
+  xshm->gc = XCreateGC(display, xshm->xw.window, 0, NULL);
+  xshm->completion_type = XShmGetEventBase(display) + ShmCompletion;
+  if (!x11_get_pixel_format(&xshm->xw, &xshm->format)) {
+    xshm_destroy(data);
+    return FALSE;
+  }
+  for (int i = 0; i < data->pattern->n_colours; ++i) {
+    const struct colour_t *c = &data->pattern->colours[i];
+    xshm->palette[i] = x11_get_pixel(xshm->xw.visual, c->r, c->g, c->b);
+  }
+  gdk_window_add_filter(NULL, &on_xshm_event, xshm);
+  xshm->pool = render_pool_new(data->threads, data->realtime);
+  if (!alloc_buffers(xshm)) {
+    xshm_destroy(data);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void xshm_update(struct data_t *data, int old_x, gboolean full) {
+  struct xshm_t *xshm = (struct xshm_t *)data->backend_data;
+  struct x11_window_t *xw = &xshm->xw;
+  if (x11_window_update_size(xw)) {
+    free_buffers(xshm);
+    if (!alloc_buffers(xshm)) {
+      g_printerr("Cannot reallocate shared memory images\n");
+      gtk_widget_destroy(data->window);
+      return;
+    }
+  }
+
+  struct xshm_buffer_t *buffer = &xshm->buffers[xshm->next_buffer];
+  if (buffer->busy) {
+    // The server hasn't finished with this image yet, so drop the frame and
+    // try again on the next tick.
+    ++data->stats.dropped_frames;
+    data->damaged = TRUE;
+    return;
+  }
+
+  xshm->image = buffer->image;
+  xshm->frame = &data->program.frame;
+  render_pool_run(xshm->pool, xw->height, &render_band, xshm);
+
+  XShmPutImage(xw->display, xw->window, xshm->gc, buffer->image, 0, 0, 0, 0,
+      xw->width, xw->height, True);
+  buffer->busy = TRUE;
+  xshm->next_buffer = (xshm->next_buffer + 1) % XSHM_BUFFERS;
+  XFlush(xw->display);
+}
+
+const struct backend_t XSHM_BACKEND = {
+  "xshm",
+  "render in client memory and share it with the X server (MIT-SHM)",
+  &xshm_init,
+  &xshm_update,
+  &xshm_destroy,
+  FALSE,
+};